@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+# Dump a trace recorded with the OpenOCD "jtag_trace" command to stdout,
+# followed by a summary of the time spent in the adapter. The format is
+# described in src/jtag/trace.h; use "jtag_trace_replay" to replay a
+# trace through an adapter.
+
+import sys
+import struct
+
+
+(JTAG_SCAN, JTAG_TLR_RESET, JTAG_RUNTEST, JTAG_RESET, JTAG_PATHMOVE,
+    JTAG_SLEEP, JTAG_STABLECLOCKS, JTAG_TMS) = (1, 2, 3, 4, 6, 7, 8, 9)
+JTAG_TRACE_FLUSH = 0x20
+(JTAG_TRACE_SWD_READ, JTAG_TRACE_SWD_WRITE, JTAG_TRACE_SWD_SEQ,
+    JTAG_TRACE_SWD_RUN) = (0x30, 0x31, 0x32, 0x33)
+
+# tap_state_t, ARM numbering
+State = ("DREXIT2", "DREXIT1", "DRSHIFT", "DRPAUSE", "IRSELECT", "DRUPDATE",
+    "DRCAPTURE", "DRSELECT", "IREXIT2", "IREXIT1", "IRSHIFT", "IRPAUSE",
+    "IDLE", "IRUPDATE", "IRCAPTURE", "RESET")
+
+SwdSeq = ("LINE_RESET", "JTAG_TO_SWD", "SWD_TO_JTAG", "SWD_TO_DORMANT",
+    "DORMANT_TO_SWD")
+
+
+def state_name(s):
+    return State[s] if s < len(State) else "INVALID"
+
+
+def hexbits(data, bits):
+    # bit 0 is the LSB of the first byte; print MSB first
+    return "%0*x" % ((bits + 3) // 4, int.from_bytes(data, "little")) if bits else "-"
+
+
+def swd_request(cmd):
+    return "%s %s 0x%x" % ("AP" if cmd & 0x02 else "DP",
+        "read" if cmd & 0x04 else "write", (cmd >> 1) & 0x0c)
+
+
+def dump_scan(payload):
+    ir_scan, end_state, num_fields = struct.unpack_from("<BBH", payload, 0)
+    print("  %s scan, end state %s" % ("IR" if ir_scan else "DR", state_name(end_state)))
+    pos = 4
+    for i in range(num_fields):
+        bits, flags = struct.unpack_from("<IB", payload, pos)
+        pos += 8
+        nbytes = (bits + 7) // 8
+        tdi = tdo = None
+        if flags & 1:
+            tdi = payload[pos:pos + nbytes]
+            pos += nbytes
+        if flags & 2:
+            tdo = payload[pos:pos + nbytes]
+            pos += nbytes
+        print("    field %d: %d bits, TDI %s, TDO %s" % (i, bits,
+            hexbits(tdi, bits) if tdi is not None else "-",
+            hexbits(tdo, bits) if tdo is not None else "-"))
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("usage: %s trace_file" % sys.argv[0])
+        sys.exit(1)
+
+    f = open(sys.argv[1], "rb")
+    magic, version = struct.unpack("<8sI", f.read(12))
+    if magic != b"OCDTRACE" or version != 1:
+        print("%s is not a version 1 trace file" % sys.argv[1])
+        sys.exit(1)
+
+    queues = 0
+    busy_us = 0
+    last_us = 0
+    while True:
+        header = f.read(16)
+        if len(header) < 16:
+            break
+        rtype, size, t_lo, t_hi = struct.unpack("<B3xIII", header)
+        payload = f.read(size)
+        last_us = t_lo | (t_hi << 32)
+
+        if rtype == JTAG_SCAN:
+            dump_scan(payload)
+        elif rtype == JTAG_TLR_RESET:
+            print("  TLR reset")
+        elif rtype == JTAG_RUNTEST:
+            cycles, end_state = struct.unpack("<IB", payload)
+            print("  runtest %d cycles, end state %s" % (cycles, state_name(end_state)))
+        elif rtype == JTAG_RESET:
+            trst, srst = struct.unpack("<bb", payload)
+            print("  reset trst %d srst %d" % (trst, srst))
+        elif rtype == JTAG_PATHMOVE:
+            print("  pathmove " + " ".join(state_name(s) for s in payload[4:]))
+        elif rtype == JTAG_SLEEP:
+            print("  sleep %d us" % struct.unpack("<I", payload))
+        elif rtype == JTAG_STABLECLOCKS:
+            print("  %d clocks" % struct.unpack("<I", payload))
+        elif rtype == JTAG_TMS:
+            bits = struct.unpack_from("<I", payload)[0]
+            print("  TMS %d bits %s" % (bits, hexbits(payload[4:], bits)))
+        elif rtype in (JTAG_TRACE_FLUSH, JTAG_TRACE_SWD_RUN):
+            retval, duration = struct.unpack("<iI", payload)
+            print("%s at %d us: result %d, %d us" % (
+                "queue" if rtype == JTAG_TRACE_FLUSH else "SWD run",
+                last_us, retval, duration))
+            queues += 1
+            busy_us += duration
+        elif rtype in (JTAG_TRACE_SWD_READ, JTAG_TRACE_SWD_WRITE):
+            cmd, data = struct.unpack("<BI", payload)
+            print("  %s 0x%08x" % (swd_request(cmd), data))
+        elif rtype == JTAG_TRACE_SWD_SEQ:
+            seq = payload[0]
+            print("  sequence %s" % (SwdSeq[seq] if seq < len(SwdSeq) else seq))
+        else:
+            print("  unknown record type 0x%02x, %d bytes" % (rtype, size))
+
+    print("%d queues executed, %d us of %d us spent in the adapter" % (queues, busy_us, last_us))
+
+
+if __name__ == "__main__":
+    main()
@@ -293,6 +293,18 @@ static void cleanup_all_fds(void)
 	cleanup_fd(srst_fd, srst_gpio);
 }
 
+/* tck=0 tms tdi, sample tdo if requested, tck=1 tms tdi */
+static void sysfsgpio_packed_cycle(int cycle)
+{
+	int tms = !!(cycle & 4);
+	int tdi = !!(cycle & 2);
+
+	sysfsgpio_write(0, tms, tdi);
+	if (cycle & 1)
+		putchar(sysfsgpio_read());
+	sysfsgpio_write(1, tms, tdi);
+}
+
 static void process_remote_protocol(void)
 {
 	int c;
@@ -313,7 +325,13 @@ static void process_remote_protocol(void)
 					(d & 1));
 		} else if (c == 'R')
 			putchar(sysfsgpio_read());
-		else
+		else if (c == '?') /* Query, advertise packed encoding */
+			putchar('P');
+		else if (c & 0x80) { /* Packed, one or two clock cycles */
+			sysfsgpio_packed_cycle((c >> 3) & 7);
+			if (c & 0x40)
+				sysfsgpio_packed_cycle(c & 7);
+		} else
 			LOG_ERROR("Unknown command '%c' received", c);
 	}
 }
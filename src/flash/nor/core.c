@@ -540,8 +540,98 @@ static int compare_section(const void *a, const void *b)
 		return -1;
 }
 
-int flash_write_unlock(struct target *target, struct image *image,
-	uint32_t *written, int erase, bool unlock)
+/* unlock, erase and program one consecutive run of an image */
+static int flash_write_run(struct target *target, struct flash_bank *c,
+	uint8_t *buffer, uint32_t run_address, uint32_t run_size, int erase, bool unlock)
+{
+	int retval = ERROR_OK;
+
+	if (unlock)
+		retval = flash_unlock_address_range(target, run_address, run_size);
+	if (retval == ERROR_OK) {
+		if (erase) {
+			/* calculate and erase sectors */
+			retval = flash_erase_address_range(target,
+					true, run_address, run_size);
+		}
+	}
+
+	if (retval == ERROR_OK) {
+		/* write flash sectors */
+		retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+	}
+
+	return retval;
+}
+
+/* Like flash_write_run(), but compare the target's checksum of each
+ * sector touched by the run with the image first, and only program the
+ * sectors which differ. Consecutive differing sectors are written as one
+ * run, so drivers still see large writes. */
+static int flash_write_run_delta(struct target *target, struct flash_bank *c,
+	uint8_t *buffer, uint32_t run_address, uint32_t run_size, int erase, bool unlock,
+	uint32_t *written, uint32_t *skipped)
+{
+	uint32_t run_offset = run_address - c->base;
+	uint32_t run_end = run_offset + run_size;
+	uint32_t pending_offset = 0, pending_size = 0;
+	int retval;
+
+	if (c->num_sectors == 0) {
+		*written += run_size;
+		return flash_write_run(target, c, buffer, run_address, run_size, erase, unlock);
+	}
+
+	for (int sector = 0; sector < c->num_sectors; sector++) {
+		uint32_t start = c->sectors[sector].offset;
+		uint32_t end = start + c->sectors[sector].size;
+
+		if (end <= run_offset || start >= run_end)
+			continue;
+		if (start < run_offset)
+			start = run_offset;
+		if (end > run_end)
+			end = run_end;
+
+		uint32_t image_crc = image_crc32_update(IMAGE_CRC32_INIT,
+				buffer + start - run_offset, end - start);
+		uint32_t target_crc;
+		retval = target_checksum_memory(target, c->base + start, end - start, &target_crc);
+		if (retval == ERROR_OK && target_crc == image_crc) {
+			LOG_DEBUG("sector %d unchanged, skipping", sector);
+			*skipped += end - start;
+
+			if (pending_size) {
+				retval = flash_write_run(target, c, buffer + pending_offset - run_offset,
+						c->base + pending_offset, pending_size, erase, unlock);
+				if (retval != ERROR_OK)
+					return retval;
+				*written += pending_size;
+				pending_size = 0;
+			}
+			continue;
+		}
+
+		if (pending_size == 0)
+			pending_offset = start;
+		pending_size = end - pending_offset;
+	}
+
+	if (pending_size) {
+		retval = flash_write_run(target, c, buffer + pending_offset - run_offset,
+				c->base + pending_offset, pending_size, erase, unlock);
+		if (retval != ERROR_OK)
+			return retval;
+		*written += pending_size;
+	}
+
+	return ERROR_OK;
+}
+
+/* write an image to flash; when @a skipped is given, only sectors whose
+ * contents differ from the image are erased and programmed */
+static int flash_write_image(struct target *target, struct image *image,
+	uint32_t *written, uint32_t *skipped, int erase, bool unlock)
 {
 	int retval = ERROR_OK;
 
@@ -555,6 +645,8 @@ int flash_write_unlock(struct target *target, struct image *image,
 
 	if (written)
 		*written = 0;
+	if (skipped)
+		*skipped = 0;
 
 	if (erase) {
 		/* assume all sectors need erasing - stops any problems
@@ -724,21 +816,17 @@ int flash_write_unlock(struct target *target, struct image *image,
 			}
 		}
 
-		retval = ERROR_OK;
-
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
-		}
-
-		if (retval == ERROR_OK) {
-			/* write flash sectors */
-			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+		if (skipped) {
+			uint32_t run_written = 0;
+			retval = flash_write_run_delta(target, c, buffer, run_address, run_size,
+					erase, unlock, &run_written, skipped);
+			if (written != NULL)
+				*written += run_written;
+		} else {
+			retval = flash_write_run(target, c, buffer, run_address, run_size,
+					erase, unlock);
+			if (written != NULL)
+				*written += run_size;	/* add run size to total written counter */
 		}
 
 		free(buffer);
@@ -747,9 +835,6 @@ int flash_write_unlock(struct target *target, struct image *image,
 			/* abort operation */
 			goto done;
 		}
-
-		if (written != NULL)
-			*written += run_size;	/* add run size to total written counter */
 	}
 
 done:
@@ -759,6 +844,18 @@ done:
 	return retval;
 }
 
+int flash_write_unlock(struct target *target, struct image *image,
+	uint32_t *written, int erase, bool unlock)
+{
+	return flash_write_image(target, image, written, NULL, erase, unlock);
+}
+
+int flash_write_delta(struct target *target, struct image *image,
+	uint32_t *written, uint32_t *skipped, int erase, bool unlock)
+{
+	return flash_write_image(target, image, written, skipped, erase, unlock);
+}
+
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, int erase)
 {
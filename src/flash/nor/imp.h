@@ -47,5 +47,9 @@ int flash_driver_read(struct flash_bank *bank,
 /* write (optional verify) an image to flash memory of the given target */
 int flash_write_unlock(struct target *target, struct image *image,
 		uint32_t *written, int erase, bool unlock);
+/* like flash_write_unlock(), but skip sectors whose on-target checksum
+ * already matches the image; @a skipped returns the bytes left alone */
+int flash_write_delta(struct target *target, struct image *image,
+		uint32_t *written, uint32_t *skipped, int erase, bool unlock);
 
 #endif /* FLASH_NOR_IMP_H */
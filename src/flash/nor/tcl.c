@@ -366,12 +366,14 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 
 	struct image image;
 	uint32_t written;
+	uint32_t skipped = 0;
 
 	int retval;
 
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool delta = false;
 
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -384,6 +386,11 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD_CTX, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "delta") == 0) {
+			delta = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "only changed sectors will be written");
 		} else
 			break;
 	}
@@ -413,7 +420,11 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
+	if (delta)
+		retval = flash_write_delta(target, &image, &written, &skipped,
+				auto_erase, auto_unlock);
+	else
+		retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
@@ -423,6 +434,8 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 		command_print(CMD_CTX, "wrote %" PRIu32 " bytes from file %s "
 			"in %fs (%0.3f KiB/s)", written, CMD_ARGV[0],
 			duration_elapsed(&bench), duration_kbps(&bench, written));
+		if (delta)
+			command_print(CMD_CTX, "skipped %" PRIu32 " unchanged bytes", skipped);
 	}
 
 	image_close(&image);
@@ -430,6 +443,170 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	return retval;
 }
 
+struct flash_write_multi {
+	struct image image;
+	uint32_t written;
+	int erase;
+	bool unlock;
+};
+
+static int flash_write_multi_target(struct target *target, void *priv)
+{
+	struct flash_write_multi *multi = priv;
+
+	return flash_write_unlock(target, &multi->image, &multi->written,
+			multi->erase, multi->unlock);
+}
+
+/* @returns true if banks of both targets drive the same flash, e.g. the
+ * banks declared for each core of a multi-core chip */
+static bool flash_targets_share_bank(struct target *a, struct target *b)
+{
+	for (struct flash_bank *p = flash_bank_list(); p; p = p->next) {
+		if (p->target != a)
+			continue;
+		for (struct flash_bank *q = flash_bank_list(); q; q = q->next) {
+			if (q->target != b || q->driver != p->driver)
+				continue;
+			/* the size is 0 until an auto-probing bank is probed */
+			if (p->base == q->base
+					|| (p->base < q->base + q->size && q->base < p->base + p->size))
+				return true;
+		}
+	}
+	return false;
+}
+
+COMMAND_HANDLER(handle_flash_write_image_multi_command)
+{
+	int retval;
+
+	/* flash auto-erase is disabled by default*/
+	int auto_erase = 0;
+	bool auto_unlock = false;
+
+	while (CMD_ARGC) {
+		if (strcmp(CMD_ARGV[0], "erase") == 0) {
+			auto_erase = 1;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "auto erase enabled");
+		} else if (strcmp(CMD_ARGV[0], "unlock") == 0) {
+			auto_unlock = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
+			command_print(CMD_CTX, "auto unlock enabled");
+		} else
+			break;
+	}
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	long long base_address = 0;
+	if (CMD_ARGC >= 3)
+		COMMAND_PARSE_NUMBER(llong, CMD_ARGV[2], base_address);
+
+	/* the first argument is a list of target names */
+	char *names = strdup(CMD_ARGV[0]);
+	if (names == NULL)
+		return ERROR_FAIL;
+
+	int num_targets = 0;
+	struct target **targets = NULL;
+	for (char *name = strtok(names, " \t"); name; name = strtok(NULL, " \t")) {
+		struct target *target = get_target(name);
+		if (target == NULL) {
+			command_print(CMD_CTX, "target '%s' not found", name);
+			free(targets);
+			free(names);
+			return ERROR_FAIL;
+		}
+		struct target **tmp = realloc(targets, (num_targets + 1) * sizeof(*targets));
+		if (tmp == NULL) {
+			free(targets);
+			free(names);
+			return ERROR_FAIL;
+		}
+		targets = tmp;
+
+		/* the targets are flashed in parallel, each must have its own flash */
+		for (int i = 0; i < num_targets; i++) {
+			if (targets[i] == target || flash_targets_share_bank(targets[i], target)) {
+				command_print(CMD_CTX, "targets '%s' and '%s' share a flash bank",
+						target_name(targets[i]), name);
+				free(targets);
+				free(names);
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+		targets[num_targets++] = target;
+	}
+	free(names);
+
+	if (num_targets == 0) {
+		free(targets);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	int opened = 0;
+	struct flash_write_multi *multi = calloc(num_targets, sizeof(*multi));
+	void **privs = calloc(num_targets, sizeof(*privs));
+	int *results = calloc(num_targets, sizeof(*results));
+	if (multi == NULL || privs == NULL || results == NULL) {
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
+	struct duration bench;
+	duration_start(&bench);
+
+	/* each target reads its own copy of the image */
+	for (; opened < num_targets; opened++) {
+		struct image *image = &multi[opened].image;
+		image->base_address_set = CMD_ARGC >= 3;
+		image->base_address = base_address;
+		image->start_address_set = 0;
+
+		retval = image_open(image, CMD_ARGV[1], (CMD_ARGC == 4) ? CMD_ARGV[3] : NULL);
+		if (retval != ERROR_OK)
+			goto done;
+
+		multi[opened].erase = auto_erase;
+		multi[opened].unlock = auto_unlock;
+		privs[opened] = &multi[opened];
+	}
+
+	retval = target_run_parallel(targets, num_targets, flash_write_multi_target,
+			privs, results);
+
+	uint32_t written = 0;
+	for (int i = 0; i < num_targets; i++) {
+		if (results[i] == ERROR_OK)
+			command_print(CMD_CTX, "%s: wrote %" PRIu32 " bytes",
+					target_name(targets[i]), multi[i].written);
+		else
+			command_print(CMD_CTX, "%s: failed", target_name(targets[i]));
+		written += multi[i].written;
+	}
+
+	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
+		command_print(CMD_CTX, "wrote %" PRIu32 " bytes from file %s to %d targets "
+			"in %fs (%0.3f KiB/s)", written, CMD_ARGV[1], num_targets,
+			duration_elapsed(&bench), duration_kbps(&bench, written));
+	}
+
+done:
+	for (int i = 0; i < opened; i++)
+		image_close(&multi[i].image);
+	free(multi);
+	free(privs);
+	free(results);
+	free(targets);
+
+	return retval;
+}
+
 COMMAND_HANDLER(handle_flash_fill_command)
 {
 	int err = ERROR_OK;
@@ -880,11 +1057,22 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [delta] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
-			"and/or erase the region to be used.  Allow optional "
+			"and/or erase the region to be used, and skip sectors "
+			"already holding the image data.  Allow optional "
 			"offset from beginning of bank (defaults to zero)",
 	},
+	{
+		.name = "write_image_multi",
+		.handler = handle_flash_write_image_multi_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[erase] [unlock] target_list filename [offset [file_type]]",
+		.help = "Write an image to the flash of several targets at "
+			"once, interleaving the transfers to each target.  "
+			"Optionally first unprotect and/or erase the region "
+			"to be used.",
+	},
 	{
 		.name = "read_bank",
 		.handler = handle_flash_read_bank_command,
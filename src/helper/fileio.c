@@ -32,12 +32,18 @@
 #include "configuration.h"
 #include "fileio.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 struct fileio_internal {
 	char *url;
 	ssize_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	/* read-only mapping of the whole file, see fileio_map() */
+	void *map;
 };
 
 static inline int fileio_close_local(struct fileio_internal *fileio);
@@ -113,6 +119,7 @@ int fileio_open(struct fileio *fileio_p,
 	fileio->type = type;
 	fileio->access = access_type;
 	fileio->url = strdup(url);
+	fileio->map = NULL;
 
 	retval = fileio_open_local(fileio);
 
@@ -139,6 +146,11 @@ int fileio_close(struct fileio *fileio_p)
 	int retval;
 	struct fileio_internal *fileio = fileio_p->fp;
 
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->size);
+#endif
+
 	retval = fileio_close_local(fileio);
 
 	free(fileio->url);
@@ -251,3 +263,36 @@ int fileio_size(struct fileio *fileio_p, int *size)
 	*size = fileio->size;
 	return ERROR_OK;
 }
+
+/**
+ * Map the whole file read-only into memory, so its contents can be used
+ * in place instead of being copied through fileio_read(). The mapping
+ * stays valid until fileio_close().
+ *
+ * Not every platform or file supports this; callers must fall back to
+ * fileio_read() when ERROR_FILEIO_OPERATION_NOT_SUPPORTED is returned.
+ */
+int fileio_map(struct fileio *fileio_p, const uint8_t **data)
+{
+	struct fileio_internal *fileio = fileio_p->fp;
+
+#ifdef HAVE_SYS_MMAN_H
+	if (!fileio->map) {
+		if (fileio->access != FILEIO_READ || fileio->size <= 0)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+
+		void *map = mmap(NULL, fileio->size, PROT_READ, MAP_PRIVATE,
+				fileno(fileio->file), 0);
+		if (map == MAP_FAILED) {
+			LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+		}
+		fileio->map = map;
+	}
+
+	*data = fileio->map;
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
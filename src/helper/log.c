@@ -34,6 +34,10 @@
 
 #include <stdarg.h>
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #ifdef _DEBUG_FREE_SPACE_
 #ifdef HAVE_MALLOC_H
 #include <malloc.h>
@@ -62,6 +66,198 @@ static const char * const log_strings[5] = {
 
 static int count;
 
+#ifdef HAVE_PTHREAD_H
+/* Serializes output and callbacks, as the JTAG I/O worker thread logs
+ * too. Recursive because log callbacks may log themselves. */
+static pthread_mutex_t log_lock;
+static bool log_lock_initialized;
+#endif
+
+#ifdef HAVE_PTHREAD_H
+/* size of the buffer between log_puts() and the asynchronous writer */
+#define LOG_RING_SIZE	(256 * 1024)
+
+/* With "log_async enable", log output is copied into this ring buffer and
+ * written to log_output by a background thread in large batches, instead
+ * of being written and flushed synchronously for every message. Writers
+ * hold log_lock; the ring's own lock is only taken to move the indices,
+ * never while formatting or doing file I/O. */
+static struct {
+	char *buf;
+	/* free running byte counters, head - tail bytes are queued */
+	size_t head;
+	size_t tail;
+	/* messages lost because the ring was full */
+	unsigned long dropped;
+	unsigned long dropped_total;
+	bool running;
+	bool stop;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t drained;
+} log_ring = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.drained = PTHREAD_COND_INITIALIZER,
+};
+
+static void *log_ring_writer(void *arg)
+{
+	pthread_mutex_lock(&log_ring.lock);
+	for (;;) {
+		while (log_ring.head == log_ring.tail && !log_ring.dropped && !log_ring.stop)
+			pthread_cond_wait(&log_ring.wake, &log_ring.lock);
+
+		if (log_ring.head == log_ring.tail && !log_ring.dropped)
+			break;
+
+		size_t pos = log_ring.tail % LOG_RING_SIZE;
+		size_t len = log_ring.head - log_ring.tail;
+		if (len > LOG_RING_SIZE - pos)
+			len = LOG_RING_SIZE - pos;
+		unsigned long dropped = log_ring.dropped;
+		log_ring.dropped = 0;
+		FILE *output = log_output;
+
+		/* the queued bytes stay put until tail moves past them */
+		pthread_mutex_unlock(&log_ring.lock);
+
+		fwrite(log_ring.buf + pos, 1, len, output);
+		if (dropped)
+			fprintf(output, "%s%lu log messages dropped, log buffer full\n",
+				log_strings[LOG_LVL_WARNING + 1], dropped);
+
+		pthread_mutex_lock(&log_ring.lock);
+		log_ring.tail += len;
+		if (log_ring.head == log_ring.tail) {
+			fflush(output);
+			pthread_cond_broadcast(&log_ring.drained);
+		}
+	}
+	fflush(log_output);
+	pthread_cond_broadcast(&log_ring.drained);
+	pthread_mutex_unlock(&log_ring.lock);
+
+	return NULL;
+}
+
+/* queue a complete message, or count it as dropped if it doesn't fit */
+static void log_ring_put(const char *data, size_t len)
+{
+	pthread_mutex_lock(&log_ring.lock);
+	if (len > LOG_RING_SIZE - (log_ring.head - log_ring.tail)) {
+		log_ring.dropped++;
+		log_ring.dropped_total++;
+	} else {
+		size_t pos = log_ring.head % LOG_RING_SIZE;
+		size_t first = len;
+		if (first > LOG_RING_SIZE - pos)
+			first = LOG_RING_SIZE - pos;
+		memcpy(log_ring.buf + pos, data, first);
+		memcpy(log_ring.buf, data + first, len - first);
+		log_ring.head += len;
+	}
+	pthread_cond_signal(&log_ring.wake);
+	pthread_mutex_unlock(&log_ring.lock);
+}
+
+/* wait until everything queued so far has been written */
+static void log_ring_drain(void)
+{
+	pthread_mutex_lock(&log_ring.lock);
+	while (log_ring.running && (log_ring.head != log_ring.tail || log_ring.dropped))
+		pthread_cond_wait(&log_ring.drained, &log_ring.lock);
+	pthread_mutex_unlock(&log_ring.lock);
+}
+
+static int log_ring_start(void)
+{
+	if (log_ring.running)
+		return ERROR_OK;
+
+	if (!log_ring.buf) {
+		log_ring.buf = malloc(LOG_RING_SIZE);
+		if (!log_ring.buf)
+			return ERROR_FAIL;
+	}
+
+	static bool exit_registered;
+	if (!exit_registered)
+		exit_registered = atexit(log_exit) == 0;
+
+	fflush(log_output);
+	log_ring.stop = false;
+	if (pthread_create(&log_ring.thread, NULL, log_ring_writer, NULL) != 0)
+		return ERROR_FAIL;
+	log_ring.running = true;
+
+	return ERROR_OK;
+}
+
+static void log_ring_stop(void)
+{
+	if (!log_ring.running)
+		return;
+
+	pthread_mutex_lock(&log_ring.lock);
+	log_ring.stop = true;
+	pthread_cond_signal(&log_ring.wake);
+	pthread_mutex_unlock(&log_ring.lock);
+
+	pthread_join(log_ring.thread, NULL);
+	log_ring.running = false;
+}
+#endif
+
+/* write formatted log output, either directly or through the ring buffer */
+static void log_output_printf(const char *format, ...)
+	__attribute__ ((format (PRINTF_ATTRIBUTE_FORMAT, 1, 2)));
+static void log_output_printf(const char *format, ...)
+{
+	va_list ap;
+
+#ifdef HAVE_PTHREAD_H
+	if (log_ring.running) {
+		char buf[256];
+		char *string = buf;
+
+		va_start(ap, format);
+		int len = vsnprintf(buf, sizeof(buf), format, ap);
+		va_end(ap);
+		if (len < 0)
+			return;
+		if ((size_t)len >= sizeof(buf)) {
+			va_start(ap, format);
+			string = alloc_vprintf(format, ap);
+			va_end(ap);
+			if (string == NULL)
+				return;
+		}
+
+		log_ring_put(string, len);
+
+		if (string != buf)
+			free(string);
+		return;
+	}
+#endif
+
+	va_start(ap, format);
+	vfprintf(log_output, format, ap);
+	va_end(ap);
+}
+
+static void log_output_flush(void)
+{
+#ifdef HAVE_PTHREAD_H
+	/* the writer flushes once it has caught up */
+	if (log_ring.running)
+		return;
+#endif
+	fflush(log_output);
+}
+
 static struct store_log_forward *log_head;
 static int log_forward_count;
 
@@ -115,7 +311,7 @@ static void log_forward(const char *file, unsigned line, const char *function, c
  * target_request.c).
  *
  */
-static void log_puts(enum log_levels level,
+static void log_puts_unlocked(enum log_levels level,
 	const char *file,
 	int line,
 	const char *function,
@@ -124,8 +320,8 @@ static void log_puts(enum log_levels level,
 	char *f;
 	if (level == LOG_LVL_OUTPUT) {
 		/* do not prepend any headers, just print out what we were given and return */
-		fputs(string, log_output);
-		fflush(log_output);
+		log_output_printf("%s", string);
+		log_output_flush();
 		return;
 	}
 
@@ -141,7 +337,7 @@ static void log_puts(enum log_levels level,
 			struct mallinfo info;
 			info = mallinfo();
 #endif
-			fprintf(log_output, "%s%d %d %s:%d %s()"
+			log_output_printf("%s%d %d %s:%d %s()"
 #ifdef _DEBUG_FREE_SPACE_
 				" %d"
 #endif
@@ -153,7 +349,7 @@ static void log_puts(enum log_levels level,
 		} else {
 			/* if we are using gdb through pipes then we do not want any output
 			 * to the pipe otherwise we get repeated strings */
-			fprintf(log_output, "%s%s",
+			log_output_printf("%s%s",
 				(level > LOG_LVL_USER) ? log_strings[level + 1] : "", string);
 		}
 	} else {
@@ -161,13 +357,32 @@ static void log_puts(enum log_levels level,
 		 *nothing. */
 	}
 
-	fflush(log_output);
+	log_output_flush();
 
 	/* Never forward LOG_LVL_DEBUG, too verbose and they can be found in the log if need be */
 	if (level <= LOG_LVL_INFO)
 		log_forward(file, line, function, string);
 }
 
+static void log_puts(enum log_levels level,
+	const char *file,
+	int line,
+	const char *function,
+	const char *string)
+{
+#ifdef HAVE_PTHREAD_H
+	if (log_lock_initialized)
+		pthread_mutex_lock(&log_lock);
+#endif
+
+	log_puts_unlocked(level, file, line, function, string);
+
+#ifdef HAVE_PTHREAD_H
+	if (log_lock_initialized)
+		pthread_mutex_unlock(&log_lock);
+#endif
+}
+
 void log_printf(enum log_levels level,
 	const char *file,
 	unsigned line,
@@ -244,10 +459,39 @@ COMMAND_HANDLER(handle_log_output_command)
 		FILE *file = fopen(CMD_ARGV[0], "w");
 
 		if (file)
-			log_output = file;
+			set_log_output(CMD_CTX, file);
+	}
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_log_async_command)
+{
+#ifdef HAVE_PTHREAD_H
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+
+		if (enable) {
+			if (log_ring_start() != ERROR_OK) {
+				LOG_ERROR("couldn't start the log writer thread");
+				return ERROR_FAIL;
+			}
+		} else
+			log_ring_stop();
 	}
 
+	command_print(CMD_CTX, "asynchronous logging %s, %lu messages dropped",
+		log_ring.running ? "enabled" : "disabled", log_ring.dropped_total);
+
 	return ERROR_OK;
+#else
+	LOG_ERROR("asynchronous logging requires thread support");
+	return ERROR_FAIL;
+#endif
 }
 
 static struct command_registration log_command_handlers[] = {
@@ -258,6 +502,14 @@ static struct command_registration log_command_handlers[] = {
 		.help = "redirect logging to a file (default: stderr)",
 		.usage = "file_name",
 	},
+	{
+		.name = "log_async",
+		.handler = handle_log_async_command,
+		.mode = COMMAND_ANY,
+		.help = "write log output from a background thread through "
+			"a buffer, dropping messages when it is full",
+		.usage = "['enable'|'disable']",
+	},
 	{
 		.name = "debug_level",
 		.handler = handle_debug_level_command,
@@ -295,15 +547,45 @@ void log_init(void)
 	if (log_output == NULL)
 		log_output = stderr;
 
+#ifdef HAVE_PTHREAD_H
+	if (!log_lock_initialized) {
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		log_lock_initialized = pthread_mutex_init(&log_lock, &attr) == 0;
+		pthread_mutexattr_destroy(&attr);
+	}
+#endif
+
 	start = last_time = timeval_ms();
 }
 
 int set_log_output(struct command_context *cmd_ctx, FILE *output)
 {
+#ifdef HAVE_PTHREAD_H
+	/* queued output belongs to the old file; holding log_lock keeps
+	 * anything new from being queued meanwhile */
+	if (log_lock_initialized)
+		pthread_mutex_lock(&log_lock);
+	log_ring_drain();
+	pthread_mutex_lock(&log_ring.lock);
+	log_output = output;
+	pthread_mutex_unlock(&log_ring.lock);
+	if (log_lock_initialized)
+		pthread_mutex_unlock(&log_lock);
+#else
 	log_output = output;
+#endif
 	return ERROR_OK;
 }
 
+void log_exit(void)
+{
+#ifdef HAVE_PTHREAD_H
+	log_ring_stop();
+#endif
+}
+
 /* add/remove log callback handler */
 int log_add_callback(log_callback_fn fn, void *priv)
 {
@@ -37,15 +37,26 @@
 
 struct cmd_queue_page {
 	void *address;
+	size_t size;
 	size_t used;
 	struct cmd_queue_page *next;
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
 static struct cmd_queue_page *cmd_queue_pages;
-
+/* page the next allocation is carved from */
+static struct cmd_queue_page *cmd_queue_tail;
+/* number of pages kept across queue resets. It follows the number of pages
+ * used by the largest recent queue and decays by one page per reset. */
+static unsigned cmd_queue_hwm_pages;
+static struct cmd_queue_stats cmd_queue_stats;
+
+/* queue being built by jtag_queue_command() */
+static struct jtag_command *cmd_queue_head;
+static struct jtag_command **next_command_pointer = &cmd_queue_head;
+
+/* queue being executed by the driver */
 struct jtag_command *jtag_command_queue;
-static struct jtag_command **next_command_pointer = &jtag_command_queue;
 
 void jtag_queue_command(struct jtag_command *cmd)
 {
@@ -61,10 +72,41 @@ void jtag_queue_command(struct jtag_command *cmd)
 	next_command_pointer = &cmd->next;
 }
 
+static struct cmd_queue_page *cmd_queue_page_alloc(size_t size)
+{
+	struct cmd_queue_page *page = malloc(sizeof(struct cmd_queue_page));
+	if (!page)
+		return NULL;
+
+	page->size = (size < CMD_QUEUE_PAGE_SIZE) ? CMD_QUEUE_PAGE_SIZE : size;
+	page->address = malloc(page->size);
+	if (!page->address) {
+		free(page);
+		return NULL;
+	}
+	page->used = 0;
+	page->next = NULL;
+
+	cmd_queue_stats.page_allocs++;
+	cmd_queue_stats.pages++;
+	cmd_queue_stats.reserved_bytes += page->size;
+
+	return page;
+}
+
+static void cmd_queue_page_free(struct cmd_queue_page *page)
+{
+	cmd_queue_stats.page_frees++;
+	cmd_queue_stats.pages--;
+	cmd_queue_stats.reserved_bytes -= page->size;
+
+	free(page->address);
+	free(page);
+}
+
 void *cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
+	struct cmd_queue_page *page = cmd_queue_tail;
 	uint8_t *t;
 
 	/*
@@ -99,49 +141,132 @@ void *cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE - 1) & (~(ALIGN_SIZE - 1));
 	/* Done... */
 
-	if (*p_page) {
-		while ((*p_page)->next)
-			p_page = &((*p_page)->next);
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
+	/* bump allocate from the tail page, moving on to the pages kept from
+	 * previous queues once it is full */
+	while (page && page->size - page->used < size)
+		page = page->next;
+
+	if (!page) {
+		page = cmd_queue_page_alloc(size);
+		if (!page)
+			return NULL;
+
+		/* link the new page right after the tail, ahead of any kept
+		 * pages too small for this request */
+		if (cmd_queue_tail) {
+			page->next = cmd_queue_tail->next;
+			cmd_queue_tail->next = page;
+		} else {
+			page->next = cmd_queue_pages;
+			cmd_queue_pages = page;
+		}
 	}
+	cmd_queue_tail = page;
+
+	t = page->address;
+	t += page->used;
+	page->used += size;
+
+	return t;
+}
 
-	if (!*p_page) {
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		size_t alloc_size = (size < CMD_QUEUE_PAGE_SIZE) ?
-					CMD_QUEUE_PAGE_SIZE : size;
-		(*p_page)->address = malloc(alloc_size);
-		(*p_page)->next = NULL;
+/* Release the spare pages exceeding the high-water mark. Pages holding
+ * commands of the queue being built are never touched. */
+static void cmd_queue_trim(void)
+{
+	struct cmd_queue_page **p_page = &cmd_queue_pages;
+	unsigned kept = 0;
+
+	while (*p_page) {
+		struct cmd_queue_page *page = *p_page;
+		bool spare = (page->used == 0) && (page != cmd_queue_tail);
+
+		/* always keep one page; oversized pages only served an
+		 * exceptionally long scan */
+		if (spare && ((kept > 0 && kept >= cmd_queue_hwm_pages) ||
+				page->size != CMD_QUEUE_PAGE_SIZE)) {
+			*p_page = page->next;
+			cmd_queue_page_free(page);
+			continue;
+		}
+
+		kept++;
+		p_page = &page->next;
 	}
+}
+
+void jtag_command_queue_detach(struct jtag_command_queue_batch *batch)
+{
+	struct cmd_queue_page **p_page = &cmd_queue_pages;
+	struct cmd_queue_page **p_batch_page = &batch->pages;
+
+	batch->commands = cmd_queue_head;
+
+	/* hand the pages holding the queue over to the batch, keep the spare
+	 * ones for the next queue */
+	while (*p_page) {
+		struct cmd_queue_page *page = *p_page;
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+		if (page->used) {
+			*p_page = page->next;
+			*p_batch_page = page;
+			p_batch_page = &page->next;
+		} else
+			p_page = &page->next;
+	}
+	*p_batch_page = NULL;
 
-	t = (*p_page)->address;
-	return t + offset;
+	cmd_queue_tail = cmd_queue_pages;
+	cmd_queue_head = NULL;
+	next_command_pointer = &cmd_queue_head;
 }
 
-static void cmd_queue_free(void)
+void jtag_command_queue_release(struct jtag_command_queue_batch *batch)
 {
-	struct cmd_queue_page *page = cmd_queue_pages;
+	struct cmd_queue_page **p_page = &cmd_queue_pages;
+	unsigned used_pages = 0;
+	size_t used_bytes = 0;
 
-	while (page) {
-		struct cmd_queue_page *last = page;
-		free(page->address);
-		page = page->next;
-		free(last);
+	for (struct cmd_queue_page *page = batch->pages; page; page = page->next) {
+		used_pages++;
+		used_bytes += page->used;
+		page->used = 0;
 	}
 
-	cmd_queue_pages = NULL;
+	cmd_queue_stats.flushes++;
+	cmd_queue_stats.last_flush_bytes = used_bytes;
+	if (used_bytes > cmd_queue_stats.peak_flush_bytes)
+		cmd_queue_stats.peak_flush_bytes = used_bytes;
+
+	if (used_pages >= cmd_queue_hwm_pages)
+		cmd_queue_hwm_pages = used_pages;
+	else if (used_pages)
+		cmd_queue_hwm_pages--;
+
+	/* recycle the pages behind those the next queue may be using */
+	while (*p_page)
+		p_page = &(*p_page)->next;
+	*p_page = batch->pages;
+	if (!cmd_queue_tail)
+		cmd_queue_tail = cmd_queue_pages;
+
+	batch->commands = NULL;
+	batch->pages = NULL;
+
+	cmd_queue_trim();
 }
 
 void jtag_command_queue_reset(void)
 {
-	cmd_queue_free();
+	struct jtag_command_queue_batch batch;
 
-	jtag_command_queue = NULL;
-	next_command_pointer = &jtag_command_queue;
+	jtag_command_queue_detach(&batch);
+	jtag_command_queue_release(&batch);
+}
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
 }
 
 enum scan_type jtag_scan_type(const struct scan_command *cmd)
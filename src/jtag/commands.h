@@ -167,9 +167,47 @@ extern struct jtag_command *jtag_command_queue;
 
 void *cmd_queue_alloc(size_t size);
 
+/** Memory usage of the command queue allocator. */
+struct cmd_queue_stats {
+	/** Number of times the queue has been reset. */
+	unsigned flushes;
+	/** Bytes allocated for the last queue executed. */
+	size_t last_flush_bytes;
+	/** Largest number of bytes allocated for a single queue. */
+	size_t peak_flush_bytes;
+	/** Pages currently held, including those kept for reuse. */
+	unsigned pages;
+	/** Bytes currently held in those pages. */
+	size_t reserved_bytes;
+	/** Pages allocated from and returned to the heap so far. */
+	unsigned page_allocs;
+	unsigned page_frees;
+};
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats);
+
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
 
+struct cmd_queue_page;
+
+/**
+ * A command queue taken away from the queue builder, so that it can be
+ * executed while the next queue is being built.
+ */
+struct jtag_command_queue_batch {
+	struct jtag_command *commands;
+	struct cmd_queue_page *pages;
+};
+
+/**
+ * Move the queued commands, and the memory holding them, into @a batch
+ * and start a new, empty queue.
+ */
+void jtag_command_queue_detach(struct jtag_command_queue_batch *batch);
+/** Recycle the memory of a batch once it has been executed. */
+void jtag_command_queue_release(struct jtag_command_queue_batch *batch);
+
 enum scan_type jtag_scan_type(const struct scan_command *cmd);
 int jtag_scan_size(const struct scan_command *cmd);
 int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd);
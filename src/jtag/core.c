@@ -50,6 +50,8 @@ static int jtag_flush_queue_count;
 
 /* Sleep this # of ms after flushing the queue */
 static int jtag_flush_queue_sleep;
+/* execute queues flushed with jtag_execute_queue_async() in a thread */
+static bool jtag_io_worker;
 
 static void jtag_add_scan_check(struct jtag_tap *active,
 		void (*jtag_add_scan)(struct jtag_tap *active,
@@ -854,6 +856,34 @@ void jtag_execute_queue_noclear(void)
 	}
 }
 
+void jtag_execute_queue_async(void)
+{
+	jtag_flush_queue_count++;
+	jtag_set_error(interface_jtag_execute_queue_async());
+}
+
+void jtag_set_io_worker(bool enable)
+{
+	/* let the worker finish before the setting changes */
+	if (jtag && jtag_io_worker && !enable) {
+		jtag_execute_queue_noclear();
+		interface_jtag_io_worker_stop();
+	}
+
+	jtag_io_worker = enable;
+}
+
+void jtag_io_worker_wait(void)
+{
+	if (jtag_io_worker)
+		interface_jtag_io_worker_wait();
+}
+
+bool jtag_get_io_worker(void)
+{
+	return jtag_io_worker;
+}
+
 int jtag_get_flush_queue_count(void)
 {
 	return jtag_flush_queue_count;
@@ -1473,6 +1503,12 @@ int adapter_quit(void)
 	if (!jtag || !jtag->quit)
 		return ERROR_OK;
 
+	/* no queue may still be in flight */
+	if (jtag_io_worker) {
+		jtag_execute_queue_noclear();
+		interface_jtag_io_worker_stop();
+	}
+
 	/* close the JTAG interface */
 	int result = jtag->quit();
 	if (ERROR_OK != result)
@@ -1621,7 +1657,10 @@ static int jtag_set_speed(int speed)
 	jtag_speed = speed;
 	/* this command can be called during CONFIG,
 	 * in which case jtag isn't initialized */
-	return jtag ? jtag->speed(speed) : ERROR_OK;
+	if (!jtag)
+		return ERROR_OK;
+	jtag_io_worker_wait();
+	return jtag->speed(speed);
 }
 
 int jtag_config_khz(unsigned khz)
@@ -1696,11 +1735,13 @@ int jtag_power_dropout(int *dropout)
 		LOG_ERROR("No Valid JTAG Interface Configured.");
 		exit(-1);
 	}
+	jtag_io_worker_wait();
 	return jtag->power_dropout(dropout);
 }
 
 int jtag_srst_asserted(int *srst_asserted)
 {
+	jtag_io_worker_wait();
 	return jtag->srst_asserted(srst_asserted);
 }
 
@@ -1830,6 +1871,7 @@ void adapter_deassert_reset(void)
 int adapter_config_trace(bool enabled, enum tpio_pin_protocol pin_protocol,
 			 uint32_t port_size, unsigned int *trace_freq)
 {
+	jtag_io_worker_wait();
 	if (jtag->config_trace)
 		return jtag->config_trace(enabled, pin_protocol, port_size,
 					  trace_freq);
@@ -1843,6 +1885,7 @@ int adapter_config_trace(bool enabled, enum tpio_pin_protocol pin_protocol,
 
 int adapter_poll_trace(uint8_t *buf, size_t *size)
 {
+	jtag_io_worker_wait();
 	if (jtag->poll_trace)
 		return jtag->poll_trace(buf, size);
 
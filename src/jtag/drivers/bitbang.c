@@ -32,9 +32,6 @@
 #include <jtag/interface.h>
 #include <jtag/commands.h>
 
-/* YUK! - but this is currently a global.... */
-extern struct jtag_interface *jtag_interface;
-
 /**
  * Function bitbang_stableclocks
  * issues a number of clock cycles while staying in a stable state.
@@ -185,10 +182,26 @@ static void bitbang_stableclocks(int num_cycles)
 	}
 }
 
+/* collect @a count queued TDO samples into @a buffer starting at @a first_bit */
+static void bitbang_read_buffered(uint8_t *buffer, int first_bit, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		int bit_cnt = first_bit + i;
+		int bytec = bit_cnt/8;
+		int bcval = 1 << (bit_cnt % 8);
+
+		if (bitbang_interface->read_sample())
+			buffer[bytec] |= bcval;
+		else
+			buffer[bytec] &= ~bcval;
+	}
+}
+
 static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int scan_size)
 {
 	tap_state_t saved_end_state = tap_get_end_state();
 	int bit_cnt;
+	size_t buffered = 0;
 
 	if (!((!ir_scan &&
 			(tap_get_state() == TAP_DRSHIFT)) ||
@@ -219,13 +232,24 @@ static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int
 
 		bitbang_interface->write(0, tms, tdi);
 
-		if (type != SCAN_OUT)
-			val = bitbang_interface->read();
+		if (type != SCAN_OUT) {
+			if (bitbang_interface->buf_size) {
+				bitbang_interface->sample();
+				buffered++;
+			} else
+				val = bitbang_interface->read();
+		}
 
 		bitbang_interface->write(1, tms, tdi);
 
 		if (type != SCAN_OUT) {
-			if (val)
+			if (bitbang_interface->buf_size) {
+				if (buffered == bitbang_interface->buf_size ||
+						bit_cnt == scan_size - 1) {
+					bitbang_read_buffered(buffer, bit_cnt + 1 - buffered, buffered);
+					buffered = 0;
+				}
+			} else if (val)
 				buffer[bytec] |= bcval;
 			else
 				buffer[bytec] &= ~bcval;
@@ -346,7 +370,6 @@ int bitbang_execute_queue(void)
 
 
 bool swd_mode;
-static int queued_retval;
 
 static int bitbang_swd_init(void)
 {
@@ -409,143 +432,61 @@ void bitbang_switch_to_swd(void)
 	bitbang_exchange(false, (uint8_t *)swd_seq_jtag_to_swd, 0, swd_seq_jtag_to_swd_len);
 }
 
-static void swd_clear_sticky_errors(struct adiv5_dap *dap)
-{
-	const struct swd_driver *swd = jtag_interface->swd;
-	assert(swd);
-
-	swd->write_reg(dap, swd_cmd(false,  false, DP_ABORT),
-		STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR);
-}
-
-static void bitbang_swd_read_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t *value)
+static void bitbang_swd_transfer_one(struct adiv5_dap *dap, struct swd_transfer *t)
 {
-	LOG_DEBUG("bitbang_swd_read_reg");
-	assert(cmd & SWD_CMD_RnW);
+	uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
+	uint8_t cmd = t->cmd | SWD_CMD_START | SWD_CMD_PARK;
 
-	if (queued_retval != ERROR_OK) {
-		LOG_DEBUG("Skip bitbang_swd_read_reg because queued_retval=%d", queued_retval);
-		return;
-	}
-
-	for (;;) {
-		uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
-
-		cmd |= SWD_CMD_START | (1 << 7);
-		bitbang_exchange(false, &cmd, 0, 8);
+	bitbang_exchange(false, &cmd, 0, 8);
 
+	if (cmd & SWD_CMD_RnW) {
 		bitbang_interface->swdio_drive(false);
 		bitbang_exchange(true, trn_ack_data_parity_trn, 0, 1 + 3 + 32 + 1 + 1);
 		bitbang_interface->swdio_drive(true);
 
-		int ack = buf_get_u32(trn_ack_data_parity_trn, 1, 3);
-		uint32_t data = buf_get_u32(trn_ack_data_parity_trn, 1 + 3, 32);
-		int parity = buf_get_u32(trn_ack_data_parity_trn, 1 + 3 + 32, 1);
-
-		LOG_DEBUG("%s %s %s reg %X = %08"PRIx32,
-			  ack == SWD_ACK_OK ? "OK" : ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK",
-			  cmd & SWD_CMD_APnDP ? "AP" : "DP",
-			  cmd & SWD_CMD_RnW ? "read" : "write",
-			  (cmd & SWD_CMD_A32) >> 1,
-			  data);
-
-		switch (ack) {
-		 case SWD_ACK_OK:
-			if (parity != parity_u32(data)) {
-				LOG_DEBUG("Wrong parity detected");
-				queued_retval = ERROR_FAIL;
-				return;
-			}
-			if (value)
-				*value = data;
-			if (cmd & SWD_CMD_APnDP)
-				bitbang_exchange(true, NULL, 0, dap->memaccess_tck);
-			return;
-		 case SWD_ACK_WAIT:
-			LOG_DEBUG("SWD_ACK_WAIT");
-			swd_clear_sticky_errors(dap);
-			break;
-		 case SWD_ACK_FAULT:
-			LOG_DEBUG("SWD_ACK_FAULT");
-			queued_retval = ack;
-			return;
-		 default:
-			LOG_DEBUG("No valid acknowledge: ack=%d", ack);
-			queued_retval = ack;
-			return;
-		}
-	}
-}
-
-static void bitbang_swd_write_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t value)
-{
-	LOG_DEBUG("bitbang_swd_write_reg");
-	assert(!(cmd & SWD_CMD_RnW));
-
-	if (queued_retval != ERROR_OK) {
-		LOG_DEBUG("Skip bitbang_swd_write_reg because queued_retval=%d", queued_retval);
-		return;
-	}
-
-	for (;;) {
-		uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
-		buf_set_u32(trn_ack_data_parity_trn, 1 + 3 + 1, 32, value);
-		buf_set_u32(trn_ack_data_parity_trn, 1 + 3 + 1 + 32, 1, parity_u32(value));
-
-		cmd |= SWD_CMD_START | (1 << 7);
-		bitbang_exchange(false, &cmd, 0, 8);
+		t->data = buf_get_u32(trn_ack_data_parity_trn, 1 + 3, 32);
+		t->parity = buf_get_u32(trn_ack_data_parity_trn, 1 + 3 + 32, 1);
+	} else {
+		buf_set_u32(trn_ack_data_parity_trn, 1 + 3 + 1, 32, t->data);
+		buf_set_u32(trn_ack_data_parity_trn, 1 + 3 + 1 + 32, 1, parity_u32(t->data));
 
 		bitbang_interface->swdio_drive(false);
 		bitbang_exchange(true, trn_ack_data_parity_trn, 0, 1 + 3 + 1);
 		bitbang_interface->swdio_drive(true);
 		bitbang_exchange(false, trn_ack_data_parity_trn, 1 + 3 + 1, 32 + 1);
-
-		int ack = buf_get_u32(trn_ack_data_parity_trn, 1, 3);
-		LOG_DEBUG("%s %s %s reg %X = %08"PRIx32,
-			  ack == SWD_ACK_OK ? "OK" : ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK",
-			  cmd & SWD_CMD_APnDP ? "AP" : "DP",
-			  cmd & SWD_CMD_RnW ? "read" : "write",
-			  (cmd & SWD_CMD_A32) >> 1,
-			  buf_get_u32(trn_ack_data_parity_trn, 1 + 3 + 1, 32));
-
-		switch (ack) {
-		 case SWD_ACK_OK:
-			if (cmd & SWD_CMD_APnDP)
-				bitbang_exchange(true, NULL, 0, dap->memaccess_tck);
-			return;
-		 case SWD_ACK_WAIT:
-			LOG_DEBUG("SWD_ACK_WAIT");
-			swd_clear_sticky_errors(dap);
-			break;
-		 case SWD_ACK_FAULT:
-			LOG_DEBUG("SWD_ACK_FAULT");
-			queued_retval = ack;
-			return;
-		 default:
-			LOG_DEBUG("No valid acknowledge: ack=%d", ack);
-			queued_retval = ack;
-			return;
-		}
 	}
+
+	t->ack = buf_get_u32(trn_ack_data_parity_trn, 1, 3);
+
+	if (t->ack == SWD_ACK_OK && (cmd & SWD_CMD_APnDP))
+		bitbang_exchange(true, NULL, 0, dap->memaccess_tck);
 }
 
-static int bitbang_swd_run_queue(struct adiv5_dap *dap)
+static int bitbang_swd_transfer(struct adiv5_dap *dap, struct swd_transfer *transfers,
+		size_t count)
 {
-	LOG_DEBUG("bitbang_swd_run_queue");
+	LOG_DEBUG("bitbang_swd_transfer");
+
+	/* The transactions are performed one by one anyway, so stop at
+	 * the first one refused instead of clocking the following ones. */
+	for (size_t i = 0; i < count; i++) {
+		bitbang_swd_transfer_one(dap, &transfers[i]);
+		if (transfers[i].ack != SWD_ACK_OK)
+			break;
+	}
+
 	/* A transaction must be followed by another transaction or at least 8 idle cycles to
 	 * ensure that data is clocked through the AP. */
 	bitbang_exchange(true, NULL, 0, 8);
 
-	int retval = queued_retval;
-	queued_retval = ERROR_OK;
-	LOG_DEBUG("SWD queue return value: %02x", retval);
-	return retval;
+	return ERROR_OK;
 }
 
 const struct swd_driver bitbang_swd = {
 	.init = bitbang_swd_init,
 	.switch_seq = bitbang_swd_switch_seq,
-	.read_reg = bitbang_swd_read_reg,
-	.write_reg = bitbang_swd_write_reg,
-	.run = bitbang_swd_run_queue,
+	.read_reg = swd_queue_read_reg,
+	.write_reg = swd_queue_write_reg,
+	.run = swd_queue_run,
+	.transfer = bitbang_swd_transfer,
 };
@@ -35,6 +35,15 @@ struct bitbang_interface {
 	void (*blink)(int on);
 	int (*swdio_read)(void);
 	void (*swdio_drive)(bool on);
+
+	/* optional callbacks for interfaces with a high read latency: TDO
+	 * samples are requested with sample() and collected later, in order,
+	 * with read_sample(). At most buf_size samples are outstanding; a
+	 * buf_size of 0 means every bit is fetched with read().
+	 */
+	void (*sample)(void);
+	int (*read_sample)(void);
+	size_t buf_size;
 };
 
 const struct swd_driver bitbang_swd;
@@ -158,8 +158,21 @@ struct pending_transfer_result {
 	void *buffer;
 };
 
+/* A packet sent to the probe whose reply was not read yet. */
+struct pending_request {
+	int first;		/* index of its first transfer */
+	int count;
+	bool block;		/* DAP_TransferBlock rather than DAP_Transfer */
+};
+
+/* Runs of at least this many accesses to the same AP register, as done by
+ * mem_ap_read/write to DRW, are sent with DAP_TransferBlock. Shorter runs
+ * are packed into DAP_Transfer together with the TAR/CSW setup. */
+#define BLOCK_MIN_TRANSFERS	8
+
 static int pending_transfer_count, pending_queue_len;
 static struct pending_transfer_result *pending_transfers;
+static struct pending_request *pending_requests;
 
 static int queued_retval;
 
@@ -260,6 +273,7 @@ static int cmsis_dap_usb_open(void)
 	dap->dev_handle = dev;
 	dap->caps = 0;
 	dap->mode = 0;
+	dap->packet_count = 1;
 
 	cmsis_dap_handle = dap;
 
@@ -299,12 +313,14 @@ static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 	cmsis_dap_serial = NULL;
 	free(pending_transfers);
 	pending_transfers = NULL;
+	free(pending_requests);
+	pending_requests = NULL;
 
 	return;
 }
 
-/* Send a message and receive the reply */
-static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
+/* Send a message without waiting for the reply */
+static int cmsis_dap_usb_write(struct cmsis_dap *dap, int txlen)
 {
 	/* Pad the rest of the TX buffer with 0's */
 	memset(dap->packet_buffer + txlen, 0, dap->packet_size - txlen);
@@ -316,8 +332,13 @@ static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 		return ERROR_FAIL;
 	}
 
-	/* get reply */
-	retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, USB_TIMEOUT);
+	return ERROR_OK;
+}
+
+/* Receive the reply to the oldest message sent */
+static int cmsis_dap_usb_read(struct cmsis_dap *dap)
+{
+	int retval = hid_read_timeout(dap->dev_handle, dap->packet_buffer, dap->packet_size, USB_TIMEOUT);
 	if (retval == -1 || retval == 0) {
 		LOG_DEBUG("error reading data: %ls", hid_error(dap->dev_handle));
 		return ERROR_FAIL;
@@ -326,6 +347,16 @@ static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
 	return ERROR_OK;
 }
 
+/* Send a message and receive the reply */
+static int cmsis_dap_usb_xfer(struct cmsis_dap *dap, int txlen)
+{
+	int retval = cmsis_dap_usb_write(dap, txlen);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return cmsis_dap_usb_read(dap);
+}
+
 static int cmsis_dap_cmd_DAP_SWJ_Pins(uint8_t pins, uint8_t mask, uint32_t delay, uint8_t *input)
 {
 	int retval;
@@ -515,30 +546,97 @@ static int cmsis_dap_cmd_DAP_Delay(uint16_t delay_us)
 }
 #endif
 
-static int cmsis_dap_swd_run_queue(struct adiv5_dap *dap)
+/* @returns the number of transfers from @a first on with the same request */
+static int cmsis_dap_swd_run_length(int first)
+{
+	int i = first + 1;
+
+	while (i < pending_transfer_count && pending_transfers[i].cmd == pending_transfers[first].cmd)
+		i++;
+	return i - first;
+}
+
+static bool cmsis_dap_swd_use_block(int first, int run)
+{
+	return (pending_transfers[first].cmd & SWD_CMD_APnDP) && run >= BLOCK_MIN_TRANSFERS;
+}
+
+/* Fill the packet buffer with a DAP_TransferBlock of @a run transfers at
+ * most, all using the request of transfer @a first.
+ * @returns the length of the packet. */
+static size_t cmsis_dap_swd_build_block(int first, int run, struct pending_request *request)
 {
 	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+	uint8_t cmd = pending_transfers[first].cmd;
+	/* the payload of a packet excludes the report number */
+	size_t max = cmsis_dap_handle->packet_size - 1;
+	int count;
+
+	if (cmd & SWD_CMD_RnW)
+		count = (max - 4) / 4;
+	else
+		count = (max - 5) / 4;
+	if (count > run)
+		count = run;
+	if (count > 0xffff)
+		count = 0xffff;
 
-	LOG_DEBUG("Executing %d queued transactions", pending_transfer_count);
+	size_t idx = 0;
+	buffer[idx++] = 0;	/* report number */
+	buffer[idx++] = CMD_DAP_TFER_BLOCK;
+	buffer[idx++] = 0x00;	/* DAP Index */
+	buffer[idx++] = count & 0xff;
+	buffer[idx++] = (count >> 8) & 0xff;
+	buffer[idx++] = (cmd >> 1) & 0x0f;
 
-	if (queued_retval != ERROR_OK) {
-		LOG_DEBUG("Skipping due to previous errors: %d", queued_retval);
-		goto skip;
+	LOG_DEBUG("%s %s reg %x, %d times", cmd & SWD_CMD_APnDP ? "AP" : "DP",
+			cmd & SWD_CMD_RnW ? "read" : "write", (cmd & SWD_CMD_A32) >> 1, count);
+
+	if (!(cmd & SWD_CMD_RnW)) {
+		for (int i = first; i < first + count; i++) {
+			h_u32_to_le(&buffer[idx], pending_transfers[i].data);
+			idx += 4;
+		}
 	}
 
-	if (!pending_transfer_count)
-		goto skip;
+	request->first = first;
+	request->count = count;
+	request->block = true;
+	return idx;
+}
+
+/* Fill the packet buffer with a DAP_Transfer of the transfers from
+ * @a first on, as many as fit in the request and in the reply.
+ * @returns the length of the packet. */
+static size_t cmsis_dap_swd_build_transfer(int first, struct pending_request *request)
+{
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+	size_t max = cmsis_dap_handle->packet_size - 1;
+	size_t reply_len = 3;
+	int i;
 
 	size_t idx = 0;
 	buffer[idx++] = 0;	/* report number */
 	buffer[idx++] = CMD_DAP_TFER;
 	buffer[idx++] = 0x00;	/* DAP Index */
-	buffer[idx++] = pending_transfer_count;
+	buffer[idx++] = 0;	/* transfer count, set below */
 
-	for (int i = 0; i < pending_transfer_count; i++) {
+	for (i = first; i < pending_transfer_count && i - first < 255; i++) {
 		uint8_t cmd = pending_transfers[i].cmd;
 		uint32_t data = pending_transfers[i].data;
 
+		/* leave long runs to DAP_TransferBlock */
+		if (i > first && cmd != pending_transfers[i - 1].cmd &&
+				cmsis_dap_swd_use_block(i, cmsis_dap_swd_run_length(i)))
+			break;
+
+		if (cmd & SWD_CMD_RnW) {
+			if (idx + 1 > max + 1 || reply_len + 4 > max)
+				break;
+			reply_len += 4;
+		} else if (idx + 5 > max + 1)
+			break;
+
 		LOG_DEBUG("%s %s reg %x %"PRIx32,
 				cmd & SWD_CMD_APnDP ? "AP" : "DP",
 				cmd & SWD_CMD_RnW ? "read" : "write",
@@ -572,27 +670,46 @@ static int cmsis_dap_swd_run_queue(struct adiv5_dap *dap)
 		}
 	}
 
-	queued_retval = cmsis_dap_usb_xfer(cmsis_dap_handle, idx);
-	if (queued_retval != ERROR_OK)
-		goto skip;
+	buffer[3] = i - first;
+	request->first = first;
+	request->count = i - first;
+	request->block = false;
+	return idx;
+}
+
+/* Check the reply to @a request in the packet buffer and store what was read. */
+static int cmsis_dap_swd_read_reply(struct pending_request *request)
+{
+	static uint32_t last_read;
+	uint8_t *buffer = cmsis_dap_handle->packet_buffer;
+	int count;
+	size_t idx;
+
+	if (request->block) {
+		count = buffer[1] + (buffer[2] << 8);
+		idx = 3;
+	} else {
+		count = buffer[1];
+		idx = 2;
+	}
 
-	idx = 2;
 	uint8_t ack = buffer[idx] & 0x07;
 	if (ack != SWD_ACK_OK || (buffer[idx] & 0x08)) {
-		LOG_DEBUG("SWD ack not OK: %d %s", buffer[idx-1],
+		LOG_DEBUG("SWD ack not OK: %d %s", count,
 			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
-		queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
-		goto skip;
+		return ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 	}
 	idx++;
 
-	if (pending_transfer_count != buffer[1])
+	if (request->count != count) {
 		LOG_ERROR("CMSIS-DAP transfer count mismatch: expected %d, got %d",
-			  pending_transfer_count, buffer[1]);
+			  request->count, count);
+		if (count > request->count)
+			count = request->count;
+	}
 
-	for (int i = 0; i < buffer[1]; i++) {
+	for (int i = request->first; i < request->first + count; i++) {
 		if (pending_transfers[i].cmd & SWD_CMD_RnW) {
-			static uint32_t last_read;
 			uint32_t data = le_to_h_u32(&buffer[idx]);
 			uint32_t tmp = data;
 			idx += 4;
@@ -611,6 +728,61 @@ static int cmsis_dap_swd_run_queue(struct adiv5_dap *dap)
 		}
 	}
 
+	return ERROR_OK;
+}
+
+/*
+ * Up to packet_count packets are sent before the first reply is read, so
+ * the probe can work on the next packet while the previous reply travels
+ * over USB. Replies come back in order. Once a packet fails, the packets
+ * still in flight are drained and their results discarded.
+ */
+static int cmsis_dap_swd_run_queue(struct adiv5_dap *dap)
+{
+	int packet_count = cmsis_dap_handle->packet_count;
+	int next = 0;
+	int head = 0, in_flight = 0;
+
+	LOG_DEBUG("Executing %d queued transactions", pending_transfer_count);
+
+	if (queued_retval != ERROR_OK) {
+		LOG_DEBUG("Skipping due to previous errors: %d", queued_retval);
+		goto skip;
+	}
+
+	while (next < pending_transfer_count || in_flight > 0) {
+		while (queued_retval == ERROR_OK && next < pending_transfer_count &&
+				in_flight < packet_count) {
+			struct pending_request *request =
+				&pending_requests[(head + in_flight) % packet_count];
+			int run = cmsis_dap_swd_run_length(next);
+			size_t len;
+
+			if (cmsis_dap_swd_use_block(next, run))
+				len = cmsis_dap_swd_build_block(next, run, request);
+			else
+				len = cmsis_dap_swd_build_transfer(next, request);
+
+			queued_retval = cmsis_dap_usb_write(cmsis_dap_handle, len);
+			if (queued_retval != ERROR_OK)
+				break;
+			next += request->count;
+			in_flight++;
+		}
+
+		if (in_flight == 0)
+			break;
+
+		int retval = cmsis_dap_usb_read(cmsis_dap_handle);
+		if (retval == ERROR_OK && queued_retval == ERROR_OK)
+			retval = cmsis_dap_swd_read_reply(&pending_requests[head]);
+		if (queued_retval == ERROR_OK)
+			queued_retval = retval;
+
+		head = (head + 1) % packet_count;
+		in_flight--;
+	}
+
 skip:
 	pending_transfer_count = 0;
 	int retval = queued_retval;
@@ -832,16 +1004,6 @@ static int cmsis_dap_init(void)
 	if (data[0] == 2) {  /* short */
 		uint16_t pkt_sz = data[1] + (data[2] << 8);
 
-		/* 4 bytes of command header + 5 bytes per register
-		 * write. For bulk read sequences just 4 bytes are
-		 * needed per transfer, so this is suboptimal. */
-		pending_queue_len = (pkt_sz - 4) / 5;
-		pending_transfers = malloc(pending_queue_len * sizeof(*pending_transfers));
-		if (!pending_transfers) {
-			LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
-			return ERROR_FAIL;
-		}
-
 		if (cmsis_dap_handle->packet_size != pkt_sz + 1) {
 			/* reallocate buffer */
 			cmsis_dap_handle->packet_size = pkt_sz + 1;
@@ -863,10 +1025,23 @@ static int cmsis_dap_init(void)
 
 	if (data[0] == 1) { /* byte */
 		uint16_t pkt_cnt = data[1];
-		cmsis_dap_handle->packet_count = pkt_cnt;
+		if (pkt_cnt > 0)
+			cmsis_dap_handle->packet_count = pkt_cnt;
 		LOG_DEBUG("CMSIS-DAP: Packet Count = %" PRId16, pkt_cnt);
 	}
 
+	/* Queue enough transfers to fill all packets the probe can buffer
+	 * with block reads, 4 bytes per transfer after the header. The
+	 * queue is split into as many packets as needed when it runs. */
+	pending_queue_len = cmsis_dap_handle->packet_count *
+		((cmsis_dap_handle->packet_size - 1 - 4) / 4);
+	pending_transfers = malloc(pending_queue_len * sizeof(*pending_transfers));
+	pending_requests = malloc(cmsis_dap_handle->packet_count * sizeof(*pending_requests));
+	if (!pending_transfers || !pending_requests) {
+		LOG_ERROR("Unable to allocate memory for CMSIS-DAP queue");
+		return ERROR_FAIL;
+	}
+
 	retval = cmsis_dap_get_status();
 	if (retval != ERROR_OK)
 		return ERROR_FAIL;
@@ -36,8 +36,13 @@
 #include <jtag/interface.h>
 #include <jtag/commands.h>
 #include <jtag/minidriver.h>
+#include <jtag/trace.h>
 #include <helper/command.h>
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 struct jtag_callback_entry {
 	struct jtag_callback_entry *next;
 
@@ -57,6 +62,233 @@ static void jtag_callback_queue_reset(void)
 	jtag_callback_queue_tail = NULL;
 }
 
+/* a flushed command queue along with the callbacks to run after it */
+struct jtag_io_batch {
+	struct jtag_command_queue_batch queue;
+	struct jtag_callback_entry *callbacks;
+	int retval;
+};
+
+/* Take the queue built so far, and its callbacks, away from the builder. */
+static void jtag_io_batch_detach(struct jtag_io_batch *batch)
+{
+	jtag_command_queue_detach(&batch->queue);
+	batch->callbacks = jtag_callback_queue_head;
+	batch->retval = ERROR_OK;
+	jtag_callback_queue_reset();
+}
+
+static int jtag_io_batch_execute(struct jtag_io_batch *batch)
+{
+	jtag_command_queue = batch->queue.commands;
+	int64_t start = jtag_trace_time();
+	int retval = default_interface_jtag_execute_queue();
+	jtag_trace_queue(jtag_command_queue, start, retval);
+	jtag_command_queue = NULL;
+
+	return retval;
+}
+
+/* Run the callbacks of an executed batch and recycle its memory. */
+static int jtag_io_batch_complete(struct jtag_io_batch *batch)
+{
+	int retval = batch->retval;
+
+	if (retval == ERROR_OK) {
+		struct jtag_callback_entry *entry;
+		for (entry = batch->callbacks; entry != NULL; entry = entry->next) {
+			retval = entry->callback(entry->data0, entry->data1, entry->data2, entry->data3);
+			if (retval != ERROR_OK)
+				break;
+		}
+	}
+
+	jtag_command_queue_release(&batch->queue);
+
+	return retval;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+/* Number of flushed queues the I/O worker may have pending. */
+#define JTAG_IO_WORKER_DEPTH 4
+
+/*
+ * The I/O worker thread executes batches handed over by
+ * interface_jtag_execute_queue_async(), so that the next queue can be
+ * built while the adapter works on the previous one. Batches are
+ * submitted, executed and completed in order; callbacks and memory
+ * recycling run in the main thread when a batch is completed, so the
+ * worker thread only ever calls into the driver. Synchronous execution
+ * waits for the worker to go idle first, so the driver is never used by
+ * both threads at once.
+ */
+static struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool running;
+	/* tells the thread to exit once it executed all batches */
+	bool stop;
+	struct jtag_io_batch batches[JTAG_IO_WORKER_DEPTH];
+	/* free running counters of batches submitted, executed and completed */
+	unsigned submitted;
+	unsigned executed;
+	unsigned completed;
+	/* first error of the completed batches, not reported yet */
+	int retval;
+} jtag_io_worker;
+
+static void *jtag_io_worker_thread(void *arg)
+{
+	pthread_mutex_lock(&jtag_io_worker.lock);
+	for (;;) {
+		while (jtag_io_worker.executed == jtag_io_worker.submitted && !jtag_io_worker.stop)
+			pthread_cond_wait(&jtag_io_worker.cond, &jtag_io_worker.lock);
+		if (jtag_io_worker.executed == jtag_io_worker.submitted)
+			break;
+
+		struct jtag_io_batch *batch =
+			&jtag_io_worker.batches[jtag_io_worker.executed % JTAG_IO_WORKER_DEPTH];
+		pthread_mutex_unlock(&jtag_io_worker.lock);
+
+		batch->retval = jtag_io_batch_execute(batch);
+
+		pthread_mutex_lock(&jtag_io_worker.lock);
+		jtag_io_worker.executed++;
+		pthread_cond_broadcast(&jtag_io_worker.cond);
+	}
+	pthread_mutex_unlock(&jtag_io_worker.lock);
+
+	return NULL;
+}
+
+static int jtag_io_worker_start(void)
+{
+	if (jtag_io_worker.running)
+		return ERROR_OK;
+
+	pthread_mutex_init(&jtag_io_worker.lock, NULL);
+	pthread_cond_init(&jtag_io_worker.cond, NULL);
+	jtag_io_worker.stop = false;
+	jtag_io_worker.retval = ERROR_OK;
+
+	if (pthread_create(&jtag_io_worker.thread, NULL, jtag_io_worker_thread, NULL) != 0) {
+		LOG_ERROR("cannot start JTAG I/O worker thread");
+		pthread_cond_destroy(&jtag_io_worker.cond);
+		pthread_mutex_destroy(&jtag_io_worker.lock);
+		return ERROR_FAIL;
+	}
+
+	jtag_io_worker.running = true;
+	return ERROR_OK;
+}
+
+/* Complete executed batches, waiting until at most @a max_pending remain. */
+static void jtag_io_worker_complete(unsigned max_pending)
+{
+	if (!jtag_io_worker.running)
+		return;
+
+	for (;;) {
+		pthread_mutex_lock(&jtag_io_worker.lock);
+		while (jtag_io_worker.submitted - jtag_io_worker.executed > max_pending)
+			pthread_cond_wait(&jtag_io_worker.cond, &jtag_io_worker.lock);
+		bool done = jtag_io_worker.completed == jtag_io_worker.executed;
+		pthread_mutex_unlock(&jtag_io_worker.lock);
+
+		if (done)
+			break;
+
+		/* batches before "executed" are no longer touched by the worker */
+		struct jtag_io_batch *batch =
+			&jtag_io_worker.batches[jtag_io_worker.completed % JTAG_IO_WORKER_DEPTH];
+		int retval = jtag_io_batch_complete(batch);
+		if (jtag_io_worker.retval == ERROR_OK)
+			jtag_io_worker.retval = retval;
+		jtag_io_worker.completed++;
+	}
+}
+
+void interface_jtag_io_worker_wait(void)
+{
+	jtag_io_worker_complete(0);
+}
+
+void interface_jtag_io_worker_stop(void)
+{
+	if (!jtag_io_worker.running)
+		return;
+
+	jtag_io_worker_complete(0);
+
+	pthread_mutex_lock(&jtag_io_worker.lock);
+	jtag_io_worker.stop = true;
+	pthread_cond_broadcast(&jtag_io_worker.cond);
+	pthread_mutex_unlock(&jtag_io_worker.lock);
+
+	pthread_join(jtag_io_worker.thread, NULL);
+	pthread_cond_destroy(&jtag_io_worker.cond);
+	pthread_mutex_destroy(&jtag_io_worker.lock);
+	jtag_io_worker.running = false;
+}
+
+/* Wait for all batches to be executed and completed.
+ * @returns the first error not reported yet. */
+static int jtag_io_worker_drain(void)
+{
+	if (!jtag_io_worker.running)
+		return ERROR_OK;
+
+	jtag_io_worker_complete(0);
+
+	int retval = jtag_io_worker.retval;
+	jtag_io_worker.retval = ERROR_OK;
+	return retval;
+}
+
+int interface_jtag_execute_queue_async(void)
+{
+	if (!jtag_get_io_worker() || jtag_io_worker_start() != ERROR_OK)
+		return interface_jtag_execute_queue();
+
+	/* make room for this batch */
+	jtag_io_worker_complete(JTAG_IO_WORKER_DEPTH - 1);
+
+	jtag_io_batch_detach(&jtag_io_worker.batches[jtag_io_worker.submitted % JTAG_IO_WORKER_DEPTH]);
+
+	pthread_mutex_lock(&jtag_io_worker.lock);
+	jtag_io_worker.submitted++;
+	pthread_cond_broadcast(&jtag_io_worker.cond);
+	pthread_mutex_unlock(&jtag_io_worker.lock);
+
+	int retval = jtag_io_worker.retval;
+	jtag_io_worker.retval = ERROR_OK;
+	return retval;
+}
+
+#else
+
+static int jtag_io_worker_drain(void)
+{
+	return ERROR_OK;
+}
+
+void interface_jtag_io_worker_wait(void)
+{
+}
+
+void interface_jtag_io_worker_stop(void)
+{
+}
+
+int interface_jtag_execute_queue_async(void)
+{
+	return interface_jtag_execute_queue();
+}
+
+#endif
+
 /**
  * Copy a struct scan_field for insertion into the queue.
  *
@@ -376,22 +608,20 @@ void interface_jtag_add_callback4(jtag_callback_t callback,
 int interface_jtag_execute_queue(void)
 {
 	static int reentry;
+	struct jtag_io_batch batch;
 
 	assert(reentry == 0);
 	reentry++;
 
-	int retval = default_interface_jtag_execute_queue();
-	if (retval == ERROR_OK) {
-		struct jtag_callback_entry *entry;
-		for (entry = jtag_callback_queue_head; entry != NULL; entry = entry->next) {
-			retval = entry->callback(entry->data0, entry->data1, entry->data2, entry->data3);
-			if (retval != ERROR_OK)
-				break;
-		}
-	}
+	/* earlier batches still in flight go first */
+	int worker_retval = jtag_io_worker_drain();
 
-	jtag_command_queue_reset();
-	jtag_callback_queue_reset();
+	jtag_io_batch_detach(&batch);
+	batch.retval = jtag_io_batch_execute(&batch);
+	int retval = jtag_io_batch_complete(&batch);
+
+	if (worker_retval != ERROR_OK)
+		retval = worker_retval;
 
 	reentry--;
 
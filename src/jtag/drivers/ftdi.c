@@ -115,12 +115,9 @@ static struct signal *signals;
 /* FIXME: Where to store per-instance data? We need an SWD context. */
 static struct swd_cmd_queue_entry {
 	uint8_t cmd;
-	uint32_t *dst;
 	uint8_t trn_ack_data_parity_trn[DIV_ROUND_UP(4 + 3 + 32 + 1 + 4, 8)];
 } *swd_cmd_queue;
-static size_t swd_cmd_queue_length;
 static size_t swd_cmd_queue_alloced;
-static int queued_retval;
 static int freq;
 
 static uint16_t output;
@@ -937,19 +934,60 @@ static void ftdi_swd_swdio_en(bool enable)
 }
 
 /**
- * Flush the MPSSE queue and process the SWD transaction queue
- * @param dap
- * @return
+ * Clock out a batch of SWD transactions, flush the MPSSE queue and collect
+ * the responses.
  */
-static int ftdi_swd_run_queue(struct adiv5_dap *dap)
+static int ftdi_swd_transfer(struct adiv5_dap *dap, struct swd_transfer *transfers,
+		size_t count)
 {
-	LOG_DEBUG("Executing %zu queued transactions", swd_cmd_queue_length);
-	int retval;
+	LOG_DEBUG("Executing %zu queued transactions", count);
 	struct signal *led = find_signal_by_name("LED");
+	int retval;
+
+	/* mpsse keeps pointers into the entries until it is flushed */
+	if (count > swd_cmd_queue_alloced) {
+		struct swd_cmd_queue_entry *q = realloc(swd_cmd_queue, count * sizeof(*swd_cmd_queue));
+		if (q == NULL) {
+			LOG_ERROR("Unable to allocate memory for SWD transactions");
+			return ERROR_FAIL;
+		}
+		swd_cmd_queue = q;
+		swd_cmd_queue_alloced = count;
+		LOG_DEBUG("Increased SWD command queue to %zu elements", swd_cmd_queue_alloced);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t data = transfers[i].data;
+
+		swd_cmd_queue[i].cmd = transfers[i].cmd | SWD_CMD_START | SWD_CMD_PARK;
+
+		mpsse_clock_data_out(mpsse_ctx, &swd_cmd_queue[i].cmd, 0, 8, SWD_MODE);
+
+		if (swd_cmd_queue[i].cmd & SWD_CMD_RnW) {
+			/* Queue a read transaction */
+			ftdi_swd_swdio_en(false);
+			mpsse_clock_data_in(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
+					0, 1 + 3 + 32 + 1 + 1, SWD_MODE);
+			ftdi_swd_swdio_en(true);
+		} else {
+			/* Queue a write transaction */
+			ftdi_swd_swdio_en(false);
+
+			mpsse_clock_data_in(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
+					0, 1 + 3 + 1, SWD_MODE);
 
-	if (queued_retval != ERROR_OK) {
-		LOG_DEBUG("Skipping due to previous errors: %d", queued_retval);
-		goto skip;
+			ftdi_swd_swdio_en(true);
+
+			buf_set_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 1, 32, data);
+			buf_set_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 1 + 32, 1, parity_u32(data));
+
+			mpsse_clock_data_out(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
+					1 + 3 + 1, 32 + 1, SWD_MODE);
+		}
+
+		/* Insert idle cycles after AP accesses to avoid WAIT */
+		if (swd_cmd_queue[i].cmd & SWD_CMD_APnDP)
+			mpsse_clock_data_out(mpsse_ctx, NULL, 0, dap->memaccess_tck, SWD_MODE);
 	}
 
 	/* A transaction must be followed by another transaction or at least 8 idle cycles to
@@ -960,117 +998,25 @@ static int ftdi_swd_run_queue(struct adiv5_dap *dap)
 	if (led)
 		ftdi_set_signal(led, '0');
 
-	queued_retval = mpsse_flush(mpsse_ctx);
-	if (queued_retval != ERROR_OK) {
+	retval = mpsse_flush(mpsse_ctx);
+	if (retval != ERROR_OK) {
 		LOG_ERROR("MPSSE failed");
-		goto skip;
+		return retval;
 	}
 
-	for (size_t i = 0; i < swd_cmd_queue_length; i++) {
-		int ack = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1, 3);
-
-		LOG_DEBUG("%s %s %s reg %X = %08"PRIx32,
-				ack == SWD_ACK_OK ? "OK" : ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK",
-				swd_cmd_queue[i].cmd & SWD_CMD_APnDP ? "AP" : "DP",
-				swd_cmd_queue[i].cmd & SWD_CMD_RnW ? "read" : "write",
-				(swd_cmd_queue[i].cmd & SWD_CMD_A32) >> 1,
-				buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn,
-						1 + 3 + (swd_cmd_queue[i].cmd & SWD_CMD_RnW ? 0 : 1), 32));
-
-		if (ack != SWD_ACK_OK) {
-			queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
-			goto skip;
-
-		} else if (swd_cmd_queue[i].cmd & SWD_CMD_RnW) {
-			uint32_t data = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3, 32);
-			int parity = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 32, 1);
-
-			if (parity != parity_u32(data)) {
-				LOG_ERROR("SWD Read data parity mismatch");
-				queued_retval = ERROR_FAIL;
-				goto skip;
-			}
-
-			if (swd_cmd_queue[i].dst != NULL)
-				*swd_cmd_queue[i].dst = data;
+	for (size_t i = 0; i < count; i++) {
+		transfers[i].ack = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1, 3);
+		if (swd_cmd_queue[i].cmd & SWD_CMD_RnW) {
+			transfers[i].data = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3, 32);
+			transfers[i].parity = buf_get_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 32, 1);
 		}
 	}
 
-skip:
-	swd_cmd_queue_length = 0;
-	retval = queued_retval;
-	queued_retval = ERROR_OK;
-
 	/* Queue a new "blink" */
-	if (led && retval == ERROR_OK)
+	if (led)
 		ftdi_set_signal(led, '1');
 
-	return retval;
-}
-
-static void ftdi_swd_queue_cmd(struct adiv5_dap *dap, uint8_t cmd, uint32_t *dst, uint32_t data)
-{
-	if (swd_cmd_queue_length >= swd_cmd_queue_alloced) {
-		/* Not enough room in the queue. Run the queue and increase its size for next time.
-		 * Note that it's not possible to avoid running the queue here, because mpsse contains
-		 * pointers into the queue which may be invalid after the realloc. */
-		queued_retval = ftdi_swd_run_queue(dap);
-		struct swd_cmd_queue_entry *q = realloc(swd_cmd_queue, swd_cmd_queue_alloced * 2 * sizeof(*swd_cmd_queue));
-		if (q != NULL) {
-			swd_cmd_queue = q;
-			swd_cmd_queue_alloced *= 2;
-			LOG_DEBUG("Increased SWD command queue to %zu elements", swd_cmd_queue_alloced);
-		}
-	}
-
-	if (queued_retval != ERROR_OK)
-		return;
-
-	size_t i = swd_cmd_queue_length++;
-	swd_cmd_queue[i].cmd = cmd | SWD_CMD_START | SWD_CMD_PARK;
-
-	mpsse_clock_data_out(mpsse_ctx, &swd_cmd_queue[i].cmd, 0, 8, SWD_MODE);
-
-	if (swd_cmd_queue[i].cmd & SWD_CMD_RnW) {
-		/* Queue a read transaction */
-		swd_cmd_queue[i].dst = dst;
-
-		ftdi_swd_swdio_en(false);
-		mpsse_clock_data_in(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
-				0, 1 + 3 + 32 + 1 + 1, SWD_MODE);
-		ftdi_swd_swdio_en(true);
-	} else {
-		/* Queue a write transaction */
-		ftdi_swd_swdio_en(false);
-
-		mpsse_clock_data_in(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
-				0, 1 + 3 + 1, SWD_MODE);
-
-		ftdi_swd_swdio_en(true);
-
-		buf_set_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 1, 32, data);
-		buf_set_u32(swd_cmd_queue[i].trn_ack_data_parity_trn, 1 + 3 + 1 + 32, 1, parity_u32(data));
-
-		mpsse_clock_data_out(mpsse_ctx, swd_cmd_queue[i].trn_ack_data_parity_trn,
-				1 + 3 + 1, 32 + 1, SWD_MODE);
-	}
-
-	/* Insert idle cycles after AP accesses to avoid WAIT */
-	if (cmd & SWD_CMD_APnDP)
-		mpsse_clock_data_out(mpsse_ctx, NULL, 0, dap->memaccess_tck, SWD_MODE);
-
-}
-
-static void ftdi_swd_read_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t *value)
-{
-	assert(cmd & SWD_CMD_RnW);
-	ftdi_swd_queue_cmd(dap, cmd, value, 0);
-}
-
-static void ftdi_swd_write_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t value)
-{
-	assert(!(cmd & SWD_CMD_RnW));
-	ftdi_swd_queue_cmd(dap, cmd, NULL, value);
+	return ERROR_OK;
 }
 
 static int_least32_t ftdi_swd_frequency(struct adiv5_dap *dap, int_least32_t hz)
@@ -1108,9 +1054,10 @@ static const struct swd_driver ftdi_swd = {
 	.init = ftdi_swd_init,
 	.frequency = ftdi_swd_frequency,
 	.switch_seq = ftdi_swd_switch_seq,
-	.read_reg = ftdi_swd_read_reg,
-	.write_reg = ftdi_swd_write_reg,
-	.run = ftdi_swd_run_queue,
+	.read_reg = swd_queue_read_reg,
+	.write_reg = swd_queue_write_reg,
+	.run = swd_queue_run,
+	.transfer = ftdi_swd_transfer,
 };
 
 static const char * const ftdi_transports[] = { "jtag", "swd", NULL };
@@ -66,6 +66,12 @@
 #define SIO_RESET_PURGE_RX 1
 #define SIO_RESET_PURGE_TX 2
 
+/* Bulk transfers kept in flight in each direction during a flush, so that
+ * the chip always has the next chunk of commands queued. The transfer size
+ * is a multiple of both full and high speed packet sizes. */
+#define MPSSE_TRANSFERS 4
+#define MPSSE_TRANSFER_SIZE 4096
+
 struct mpsse_ctx {
 	libusb_context *usb_ctx;
 	libusb_device_handle *usb_dev;
@@ -85,6 +91,8 @@ struct mpsse_ctx {
 	unsigned read_count;
 	uint8_t *read_chunk;
 	unsigned read_chunk_size;
+	struct libusb_transfer *write_transfers[MPSSE_TRANSFERS];
+	struct libusb_transfer *read_transfers[MPSSE_TRANSFERS];
 	struct bit_copy_queue read_queue;
 	int retval;
 };
@@ -272,15 +280,23 @@ struct mpsse_ctx *mpsse_open(const uint16_t *vid, const uint16_t *pid, const cha
 		return 0;
 
 	bit_copy_queue_init(&ctx->read_queue);
-	ctx->read_chunk_size = 16384;
+	ctx->read_chunk_size = MPSSE_TRANSFER_SIZE;
 	ctx->read_size = 16384;
 	ctx->write_size = 16384;
-	ctx->read_chunk = malloc(ctx->read_chunk_size);
+	ctx->read_chunk = malloc(ctx->read_chunk_size * MPSSE_TRANSFERS);
 	ctx->read_buffer = malloc(ctx->read_size);
 	ctx->write_buffer = malloc(ctx->write_size);
 	if (!ctx->read_chunk || !ctx->read_buffer || !ctx->write_buffer)
 		goto error;
 
+	/* the transfers are reused by every flush */
+	for (int i = 0; i < MPSSE_TRANSFERS; i++) {
+		ctx->write_transfers[i] = libusb_alloc_transfer(0);
+		ctx->read_transfers[i] = libusb_alloc_transfer(0);
+		if (!ctx->write_transfers[i] || !ctx->read_transfers[i])
+			goto error;
+	}
+
 	ctx->interface = channel;
 	ctx->index = channel + 1;
 	ctx->usb_read_timeout = 5000;
@@ -348,6 +364,12 @@ void mpsse_close(struct mpsse_ctx *ctx)
 		free(ctx->read_buffer);
 	if (ctx->read_chunk)
 		free(ctx->read_chunk);
+	for (int i = 0; i < MPSSE_TRANSFERS; i++) {
+		if (ctx->write_transfers[i])
+			libusb_free_transfer(ctx->write_transfers[i]);
+		if (ctx->read_transfers[i])
+			libusb_free_transfer(ctx->read_transfers[i]);
+	}
 
 	free(ctx);
 }
@@ -718,8 +740,17 @@ int mpsse_set_frequency(struct mpsse_ctx *ctx, int frequency)
 /* Context needed by the callbacks */
 struct transfer_result {
 	struct mpsse_ctx *ctx;
-	bool done;
-	unsigned transferred;
+	/* bytes of the write buffer handed to transfers so far */
+	unsigned write_submitted;
+	unsigned write_transferred;
+	unsigned read_transferred;
+	bool read_done;
+	bool failed;
+	int writes_in_flight;
+	int reads_in_flight;
+	/* transfers of the pools submitted in this flush, from the first one */
+	int writes_used;
+	int reads_used;
 };
 
 static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
@@ -732,32 +763,56 @@ static LIBUSB_CALL void read_cb(struct libusb_transfer *transfer)
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
 	/* Strip the two status bytes sent at the beginning of each USB packet
-	 * while copying the chunk buffer to the read buffer */
+	 * while copying the chunk buffer straight to its place in the read
+	 * buffer. Transfers on the endpoint complete in submission order. */
 	unsigned num_packets = DIV_ROUND_UP(transfer->actual_length, packet_size);
 	unsigned chunk_remains = transfer->actual_length;
-	for (unsigned i = 0; i < num_packets && chunk_remains > 2; i++) {
+	for (unsigned i = 0; i < num_packets && chunk_remains > 2 && !res->read_done; i++) {
 		unsigned this_size = packet_size - 2;
 		if (this_size > chunk_remains - 2)
 			this_size = chunk_remains - 2;
-		if (this_size > ctx->read_count - res->transferred)
-			this_size = ctx->read_count - res->transferred;
-		memcpy(ctx->read_buffer + res->transferred,
-			ctx->read_chunk + packet_size * i + 2,
+		if (this_size > ctx->read_count - res->read_transferred)
+			this_size = ctx->read_count - res->read_transferred;
+		memcpy(ctx->read_buffer + res->read_transferred,
+			transfer->buffer + packet_size * i + 2,
 			this_size);
-		res->transferred += this_size;
+		res->read_transferred += this_size;
 		chunk_remains -= this_size + 2;
-		if (res->transferred == ctx->read_count) {
-			res->done = true;
-			break;
-		}
+		if (res->read_transferred == ctx->read_count)
+			res->read_done = true;
 	}
 
-	DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length, res->transferred,
-		ctx->read_count);
+	DEBUG_IO("raw chunk %d, transferred %d of %d", transfer->actual_length,
+		res->read_transferred, ctx->read_count);
 
-	if (!res->done)
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED &&
+			transfer->status != LIBUSB_TRANSFER_CANCELLED)
+		res->failed = true;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED && !res->read_done && !res->failed &&
+			libusb_submit_transfer(transfer) == LIBUSB_SUCCESS)
+		return;
+
+	res->reads_in_flight--;
+}
+
+/* Hand the next chunk of the write buffer to @a transfer. */
+static int submit_write_chunk(struct transfer_result *res, struct libusb_transfer *transfer)
+{
+	struct mpsse_ctx *ctx = res->ctx;
+	unsigned this_size = ctx->write_count - res->write_submitted;
+
+	if (this_size > MPSSE_TRANSFER_SIZE)
+		this_size = MPSSE_TRANSFER_SIZE;
+
+	transfer->buffer = ctx->write_buffer + res->write_submitted;
+	transfer->length = this_size;
+
+	int retval = libusb_submit_transfer(transfer);
+	if (retval == LIBUSB_SUCCESS)
+		res->write_submitted += this_size;
+
+	return retval;
 }
 
 static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
@@ -765,20 +820,30 @@ static LIBUSB_CALL void write_cb(struct libusb_transfer *transfer)
 	struct transfer_result *res = transfer->user_data;
 	struct mpsse_ctx *ctx = res->ctx;
 
-	res->transferred += transfer->actual_length;
+	res->write_transferred += transfer->actual_length;
 
-	DEBUG_IO("transferred %d of %d", res->transferred, ctx->write_count);
+	DEBUG_IO("transferred %d of %d", res->write_transferred, ctx->write_count);
 
 	DEBUG_PRINT_BUF(transfer->buffer, transfer->actual_length);
 
-	if (res->transferred == ctx->write_count)
-		res->done = true;
-	else {
-		transfer->length = ctx->write_count - res->transferred;
-		transfer->buffer = ctx->write_buffer + res->transferred;
-		if (libusb_submit_transfer(transfer) != LIBUSB_SUCCESS)
-			res->done = true;
-	}
+	/* A short write can't be retried, the following chunks are already
+	 * queued behind it */
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+			transfer->actual_length != transfer->length)
+		res->failed = true;
+	else if (res->write_submitted < ctx->write_count &&
+			submit_write_chunk(res, transfer) == LIBUSB_SUCCESS)
+		return;
+
+	res->writes_in_flight--;
+}
+
+/* Cancel the first @a count transfers of a pool. The others were never
+ * submitted: old libusb versions crash on those, having no device handle. */
+static void cancel_transfers(struct libusb_transfer **transfers, int count)
+{
+	for (int i = 0; i < count; i++)
+		libusb_cancel_transfer(transfers[i]);
 }
 
 int mpsse_flush(struct mpsse_ctx *ctx)
@@ -799,54 +864,77 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 	if (ctx->write_count == 0)
 		return retval;
 
-	struct libusb_transfer *read_transfer = 0;
-	struct transfer_result read_result = { .ctx = ctx, .done = true };
+	struct transfer_result res = { .ctx = ctx, .read_done = true };
 	if (ctx->read_count) {
 		buffer_write_byte(ctx, 0x87); /* SEND_IMMEDIATE */
-		read_result.done = false;
+		res.read_done = false;
 		/* delay read transaction to ensure the FTDI chip can support us with data
 		   immediately after processing the MPSSE commands in the write transaction */
 	}
 
-	struct transfer_result write_result = { .ctx = ctx, .done = false };
-	struct libusb_transfer *write_transfer = libusb_alloc_transfer(0);
-	libusb_fill_bulk_transfer(write_transfer, ctx->usb_dev, ctx->out_ep, ctx->write_buffer,
-		ctx->write_count, write_cb, &write_result, ctx->usb_write_timeout);
-	retval = libusb_submit_transfer(write_transfer);
+	/* keep several chunks of commands queued, so the chip never starves */
+	retval = LIBUSB_SUCCESS;
+	for (int i = 0; i < MPSSE_TRANSFERS && res.write_submitted < ctx->write_count; i++) {
+		libusb_fill_bulk_transfer(ctx->write_transfers[i], ctx->usb_dev, ctx->out_ep,
+			NULL, 0, write_cb, &res, ctx->usb_write_timeout);
+		retval = submit_write_chunk(&res, ctx->write_transfers[i]);
+		if (retval != LIBUSB_SUCCESS)
+			break;
+		res.writes_in_flight++;
+		res.writes_used++;
+	}
 
-	if (ctx->read_count) {
-		read_transfer = libusb_alloc_transfer(0);
-		libusb_fill_bulk_transfer(read_transfer, ctx->usb_dev, ctx->in_ep, ctx->read_chunk,
-			ctx->read_chunk_size, read_cb, &read_result,
-			ctx->usb_read_timeout);
-		retval = libusb_submit_transfer(read_transfer);
+	for (int i = 0; i < MPSSE_TRANSFERS && !res.read_done && retval == LIBUSB_SUCCESS; i++) {
+		libusb_fill_bulk_transfer(ctx->read_transfers[i], ctx->usb_dev, ctx->in_ep,
+			ctx->read_chunk + ctx->read_chunk_size * i, ctx->read_chunk_size,
+			read_cb, &res, ctx->usb_read_timeout);
+		retval = libusb_submit_transfer(ctx->read_transfers[i]);
+		if (retval != LIBUSB_SUCCESS)
+			break;
+		res.reads_in_flight++;
+		res.reads_used++;
 	}
 
+	if (retval != LIBUSB_SUCCESS)
+		res.failed = true;
+
 	/* Polling loop, more or less taken from libftdi */
-	while (!write_result.done || !read_result.done) {
-		retval = libusb_handle_events(ctx->usb_ctx);
+	bool cancelled_reads = false;
+	bool cancelled_all = false;
+	while (res.writes_in_flight || res.reads_in_flight) {
+		if (res.failed && !cancelled_all) {
+			cancel_transfers(ctx->write_transfers, res.writes_used);
+			cancel_transfers(ctx->read_transfers, res.reads_used);
+			cancelled_all = true;
+		} else if (res.read_done && !cancelled_reads) {
+			/* the spare read transfers would only collect status bytes */
+			cancel_transfers(ctx->read_transfers, res.reads_used);
+			cancelled_reads = true;
+		}
+
+		int err = libusb_handle_events(ctx->usb_ctx);
 		keep_alive();
-		if (retval != LIBUSB_SUCCESS && retval != LIBUSB_ERROR_INTERRUPTED) {
-			libusb_cancel_transfer(write_transfer);
-			if (read_transfer)
-				libusb_cancel_transfer(read_transfer);
-			while (!write_result.done || !read_result.done)
-				if (libusb_handle_events(ctx->usb_ctx) != LIBUSB_SUCCESS)
-					break;
+		if (err != LIBUSB_SUCCESS && err != LIBUSB_ERROR_INTERRUPTED) {
+			/* Cancel everything, but keep handling events until all
+			 * transfers are done: they point to res on our stack and
+			 * are reused by the next flush */
+			if (retval == LIBUSB_SUCCESS)
+				retval = err;
+			res.failed = true;
 		}
 	}
 
 	if (retval != LIBUSB_SUCCESS) {
 		LOG_ERROR("libusb_handle_events() failed with %s", libusb_error_name(retval));
 		retval = ERROR_FAIL;
-	} else if (write_result.transferred < ctx->write_count) {
+	} else if (res.write_transferred < ctx->write_count) {
 		LOG_ERROR("ftdi device did not accept all data: %d, tried %d",
-			write_result.transferred,
+			res.write_transferred,
 			ctx->write_count);
 		retval = ERROR_FAIL;
-	} else if (read_result.transferred < ctx->read_count) {
+	} else if (res.read_transferred < ctx->read_count) {
 		LOG_ERROR("ftdi device did not return all data: %d, expected %d",
-			read_result.transferred,
+			res.read_transferred,
 			ctx->read_count);
 		retval = ERROR_FAIL;
 	} else if (ctx->read_count) {
@@ -860,10 +948,6 @@ int mpsse_flush(struct mpsse_ctx *ctx)
 		retval = ERROR_OK;
 	}
 
-	libusb_free_transfer(write_transfer);
-	if (read_transfer)
-		libusb_free_transfer(read_transfer);
-
 	if (retval != ERROR_OK)
 		mpsse_purge(ctx);
 
@@ -32,6 +32,20 @@
 /* arbitrary limit on host name length: */
 #define REMOTE_BITBANG_HOST_MAX 255
 
+/* Number of TDO samples requested before the responses are collected. The
+ * server answers with one byte per sample, which must fit into its socket
+ * send buffer while it is still receiving the rest of the batch. */
+#define REMOTE_BITBANG_BUF_SIZE 1024
+
+/* Packed encoding, used once the server advertised support for it: bytes
+ * with bit 7 set describe up to two complete clock cycles, each one being
+ * "tck=0 tms tdi, optionally sample tdo, tck=1 tms tdi". */
+#define REMOTE_BITBANG_PACKED		0x80
+#define REMOTE_BITBANG_PACKED_TWO	0x40
+#define REMOTE_BITBANG_PACKED_TMS	0x4
+#define REMOTE_BITBANG_PACKED_TDI	0x2
+#define REMOTE_BITBANG_PACKED_SAMPLE	0x1
+
 #define REMOTE_BITBANG_RAISE_ERROR(expr ...) \
 	do { \
 		LOG_ERROR(expr); \
@@ -42,6 +56,20 @@
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
+/* ask the server for packed encoding support at init */
+static bool remote_bitbang_probe_packed;
+/* the server accepts the packed encoding */
+static bool remote_bitbang_packed;
+
+/* packed encoding state: the clock cycles gathered for the next packed
+ * byte, and the tck=0 half of a cycle still waiting for its tck=1 half */
+static unsigned remote_bitbang_packed_cycles;
+static uint8_t remote_bitbang_packed_byte;
+static bool remote_bitbang_low_pending;
+static int remote_bitbang_low_tms;
+static int remote_bitbang_low_tdi;
+static bool remote_bitbang_low_sample;
+
 FILE *remote_bitbang_in;
 FILE *remote_bitbang_out;
 
@@ -51,8 +79,49 @@ static void remote_bitbang_putc(int c)
 		REMOTE_BITBANG_RAISE_ERROR("remote_bitbang_putc: %s", strerror(errno));
 }
 
+static void remote_bitbang_putc_write(int tck, int tms, int tdi)
+{
+	char c = '0' + ((tck ? 0x4 : 0x0) | (tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
+	remote_bitbang_putc(c);
+}
+
+/* Send out whatever the packed encoder is holding back, so that the next
+ * request is seen by the server in the right order. */
+static void remote_bitbang_flush_packed(void)
+{
+	if (remote_bitbang_packed_cycles) {
+		remote_bitbang_putc(remote_bitbang_packed_byte);
+		remote_bitbang_packed_cycles = 0;
+	}
+
+	if (remote_bitbang_low_pending) {
+		remote_bitbang_putc_write(0, remote_bitbang_low_tms, remote_bitbang_low_tdi);
+		if (remote_bitbang_low_sample)
+			remote_bitbang_putc('R');
+		remote_bitbang_low_pending = false;
+	}
+}
+
+static void remote_bitbang_add_packed_cycle(int tms, int tdi, bool sample)
+{
+	uint8_t cycle = (tms ? REMOTE_BITBANG_PACKED_TMS : 0) |
+		(tdi ? REMOTE_BITBANG_PACKED_TDI : 0) |
+		(sample ? REMOTE_BITBANG_PACKED_SAMPLE : 0);
+
+	if (remote_bitbang_packed_cycles == 0) {
+		remote_bitbang_packed_byte = REMOTE_BITBANG_PACKED | (cycle << 3);
+		remote_bitbang_packed_cycles = 1;
+	} else {
+		remote_bitbang_packed_byte |= REMOTE_BITBANG_PACKED_TWO | cycle;
+		remote_bitbang_putc(remote_bitbang_packed_byte);
+		remote_bitbang_packed_cycles = 0;
+	}
+}
+
 static int remote_bitbang_quit(void)
 {
+	remote_bitbang_flush_packed();
+
 	if (EOF == fputc('Q', remote_bitbang_out)) {
 		LOG_ERROR("fputs: %s", strerror(errno));
 		return ERROR_FAIL;
@@ -80,6 +149,8 @@ static int remote_bitbang_quit(void)
 /* Get the next read response. */
 static int remote_bitbang_rread(void)
 {
+	remote_bitbang_flush_packed();
+
 	if (EOF == fflush(remote_bitbang_out)) {
 		remote_bitbang_quit();
 		REMOTE_BITBANG_RAISE_ERROR("fflush: %s", strerror(errno));
@@ -98,27 +169,61 @@ static int remote_bitbang_rread(void)
 	}
 }
 
-static int remote_bitbang_read(void)
+/* Request a TDO sample; the response is only fetched by
+ * remote_bitbang_rread(), so a whole scan costs a single round trip. */
+static void remote_bitbang_sample(void)
 {
+	if (remote_bitbang_low_pending && !remote_bitbang_low_sample) {
+		remote_bitbang_low_sample = true;
+		return;
+	}
+
+	remote_bitbang_flush_packed();
 	remote_bitbang_putc('R');
+}
+
+static int remote_bitbang_read(void)
+{
+	remote_bitbang_sample();
 	return remote_bitbang_rread();
 }
 
 static void remote_bitbang_write(int tck, int tms, int tdi)
 {
-	char c = '0' + ((tck ? 0x4 : 0x0) | (tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
-	remote_bitbang_putc(c);
+	if (!remote_bitbang_packed) {
+		remote_bitbang_putc_write(tck, tms, tdi);
+		return;
+	}
+
+	if (!tck) {
+		/* hold back the falling edge until we know whether it starts
+		 * a complete clock cycle */
+		remote_bitbang_flush_packed();
+		remote_bitbang_low_pending = true;
+		remote_bitbang_low_tms = tms;
+		remote_bitbang_low_tdi = tdi;
+		remote_bitbang_low_sample = false;
+	} else if (remote_bitbang_low_pending && tms == remote_bitbang_low_tms &&
+			tdi == remote_bitbang_low_tdi) {
+		remote_bitbang_low_pending = false;
+		remote_bitbang_add_packed_cycle(tms, tdi, remote_bitbang_low_sample);
+	} else {
+		remote_bitbang_flush_packed();
+		remote_bitbang_putc_write(tck, tms, tdi);
+	}
 }
 
 static void remote_bitbang_reset(int trst, int srst)
 {
 	char c = 'r' + ((trst ? 0x2 : 0x0) | (srst ? 0x1 : 0x0));
+	remote_bitbang_flush_packed();
 	remote_bitbang_putc(c);
 }
 
 static void remote_bitbang_blink(int on)
 {
 	char c = on ? 'B' : 'b';
+	remote_bitbang_flush_packed();
 	remote_bitbang_putc(c);
 }
 
@@ -127,8 +232,47 @@ static struct bitbang_interface remote_bitbang_bitbang = {
 	.write = &remote_bitbang_write,
 	.reset = &remote_bitbang_reset,
 	.blink = &remote_bitbang_blink,
+	.sample = &remote_bitbang_sample,
+	.read_sample = &remote_bitbang_rread,
+	.buf_size = REMOTE_BITBANG_BUF_SIZE,
 };
 
+/* Ask the server whether it supports the packed encoding. A '?' is sent
+ * followed by a read request: servers knowing the query answer it with
+ * 'P' before the read response, older ones skip it and only answer the
+ * read with '0' or '1'. */
+static int remote_bitbang_query_packed(void)
+{
+	remote_bitbang_putc('?');
+	remote_bitbang_putc('R');
+
+	if (EOF == fflush(remote_bitbang_out)) {
+		LOG_ERROR("fflush: %s", strerror(errno));
+		return ERROR_FAIL;
+	}
+
+	int c = fgetc(remote_bitbang_in);
+	if (c == '0' || c == '1') {
+		LOG_INFO("remote_bitbang server does not support packed encoding");
+		return ERROR_OK;
+	}
+	if (c != 'P') {
+		LOG_ERROR("remote_bitbang: invalid query response: %c(%i)", c, c);
+		return ERROR_FAIL;
+	}
+
+	/* now the response to the read request */
+	c = fgetc(remote_bitbang_in);
+	if (c != '0' && c != '1') {
+		LOG_ERROR("remote_bitbang: invalid read response: %c(%i)", c, c);
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("remote_bitbang using packed encoding");
+	remote_bitbang_packed = true;
+	return ERROR_OK;
+}
+
 static int remote_bitbang_init_tcp(void)
 {
 	struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
@@ -227,6 +371,12 @@ static int remote_bitbang_init(void)
 		return ERROR_FAIL;
 	}
 
+	remote_bitbang_packed = false;
+	if (remote_bitbang_probe_packed && remote_bitbang_query_packed() != ERROR_OK) {
+		fclose(remote_bitbang_out);
+		return ERROR_FAIL;
+	}
+
 	LOG_INFO("remote_bitbang driver initialized");
 	return ERROR_OK;
 }
@@ -253,6 +403,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_packed_command)
+{
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], remote_bitbang_probe_packed);
+		return ERROR_OK;
+	}
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 static const struct command_registration remote_bitbang_command_handlers[] = {
 	{
 		.name = "remote_bitbang_port",
@@ -270,6 +429,14 @@ static const struct command_registration remote_bitbang_command_handlers[] = {
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "remote_bitbang_packed",
+		.handler = remote_bitbang_handle_remote_bitbang_packed_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Use the packed encoding (two clock cycles per byte) if\n"
+			"  the remote jtag server advertises support for it.",
+		.usage = "('enable'|'disable')",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
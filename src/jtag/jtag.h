@@ -571,6 +571,28 @@ int jtag_execute_queue(void);
 /** same as jtag_execute_queue() but does not clear the error flag */
 void jtag_execute_queue_noclear(void);
 
+/**
+ * Flush the queue without waiting for it to be executed. With the I/O
+ * worker enabled (see jtag_set_io_worker()) the queue is handed to a
+ * separate thread, so the caller can build the next queue while the
+ * adapter works on this one.
+ *
+ * The caller must keep the in_value buffers and callback data of the
+ * flushed queue valid until the next jtag_execute_queue(), which waits
+ * for all flushed queues and returns their errors. This suits long
+ * write-only sequences such as flash programming.
+ */
+void jtag_execute_queue_async(void);
+
+/** Enable or disable executing asynchronously flushed queues in a thread. */
+void jtag_set_io_worker(bool enable);
+bool jtag_get_io_worker(void);
+/**
+ * Wait until the I/O worker is idle, before the adapter is used other
+ * than through the JTAG queue (SWD, clock speed, trace...).
+ */
+void jtag_io_worker_wait(void);
+
 /** @returns the number of times the scan queue has been flushed */
 int jtag_get_flush_queue_count(void);
 
@@ -82,6 +82,18 @@ int interface_jtag_add_reset(int trst, int srst);
 int interface_jtag_add_sleep(uint32_t us);
 int interface_jtag_add_clocks(int num_cycles);
 int interface_jtag_execute_queue(void);
+/**
+ * Start executing the queue but return without waiting for it to
+ * complete, see jtag_execute_queue_async().
+ */
+int interface_jtag_execute_queue_async(void);
+/**
+ * Wait until no asynchronously flushed queue is being executed. Their
+ * errors are kept for the next interface_jtag_execute_queue().
+ */
+void interface_jtag_io_worker_wait(void);
+/** Wait for the asynchronously flushed queues and end the I/O worker. */
+void interface_jtag_io_worker_stop(void);
 
 /**
  * Calls the interface callback to execute the queue.  This routine
@@ -46,6 +46,19 @@ int interface_jtag_execute_queue(void)
 	return ERROR_OK;
 }
 
+int interface_jtag_execute_queue_async(void)
+{
+	return interface_jtag_execute_queue();
+}
+
+void interface_jtag_io_worker_wait(void)
+{
+}
+
+void interface_jtag_io_worker_stop(void)
+{
+}
+
 int interface_jtag_add_ir_scan(struct jtag_tap *active, const struct scan_field *fields,
 		tap_state_t state)
 {
@@ -121,6 +121,25 @@ static const uint8_t swd_seq_dormant_to_swd[] = {
 };
 static const unsigned swd_seq_dormant_to_swd_len = 199;
 
+/**
+ * One transaction of the generic SWD queue, see swd_driver.transfer().
+ */
+struct swd_transfer {
+	/** Command byte with APnDP/RnW/addr/parity bits, as from swd_cmd() */
+	uint8_t cmd;
+	/** ACK received, set by the driver */
+	uint8_t ack;
+	/** Parity bit received with read data, set by the driver */
+	bool parity;
+	/** Value to write, or value read */
+	uint32_t data;
+	/** Where the scheduler stores read data once it was checked */
+	uint32_t *dst;
+};
+
+/** swd_transfer.ack of transactions the driver didn't perform */
+#define SWD_ACK_NOT_DONE	0xff
+
 enum swd_special_seq {
 	LINE_RESET,
 	JTAG_TO_SWD,
@@ -209,8 +228,39 @@ struct swd_driver {
 	 * @return ERROR_OK on success, else a negative fault code.
 	 */
 	int *(*trace)(struct adiv5_dap *dap, bool swo);
+
+	/**
+	 * Perform SWD transactions back to back, without any retries.
+	 *
+	 * Drivers which implement this can use swd_queue_read_reg(),
+	 * swd_queue_write_reg() and swd_queue_run() as their read_reg,
+	 * write_reg and run methods. The generic queue then batches the
+	 * transactions and handles WAIT responses for them. Note that it
+	 * sets CORUNDETECT in every DP CTRL/STAT write it queues.
+	 *
+	 * The driver stores the ACK of each transaction, and the data and
+	 * parity bit of each read, in @a transfers. It must always clock
+	 * the data phase, as required with overrun detection, and add
+	 * dap->memaccess_tck idle cycles after AP accesses. It may stop
+	 * after the first transaction not acknowledged with OK.
+	 *
+	 * @param dap The DAP controlled by the SWD link.
+	 * @param transfers The transactions, with all ACKs set to
+	 * SWD_ACK_NOT_DONE.
+	 * @param count Number of transactions.
+	 * @return ERROR_OK if the ACKs could be collected, else a negative
+	 * error code for a failure of the adapter.
+	 */
+	int (*transfer)(struct adiv5_dap *dap, struct swd_transfer *transfers,
+			size_t count);
 };
 
+/* Generic queue for drivers with swd_driver.transfer(). Writes of the DP
+ * CTRL/STAT register silently get CORUNDETECT ORed in. */
+void swd_queue_read_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t *value);
+void swd_queue_write_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t value);
+int swd_queue_run(struct adiv5_dap *dap);
+
 int swd_init_reset(struct command_context *cmd_ctx);
 void swd_add_reset(int req_srst);
 
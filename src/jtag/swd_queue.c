@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+/**
+ * @file
+ * Generic SWD transaction queue for drivers which implement
+ * swd_driver.transfer().
+ *
+ * Transactions are collected until the queue runs and are then handed to
+ * the driver in one batch. Every write of the DP CTRL/STAT register enables
+ * overrun detection: once a transaction gets a WAIT response, the DP then
+ * answers every following transaction with FAULT, without performing it,
+ * until STICKYORUN is cleared through the ABORT register. So the driver
+ * doesn't have to check each ACK before sending the next transaction, and
+ * after a WAIT the queue simply clears the flag and resumes with the
+ * transaction which was refused, backing off exponentially while the
+ * target keeps answering WAIT. If a transaction after the WAIT was
+ * performed anyway, the queue fails instead of repeating it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "interface.h"
+#include "swd.h"
+#include <helper/time_support.h>
+
+/* YUK! - but this is currently a global.... */
+extern struct jtag_interface *jtag_interface;
+
+/* Give up on a transaction which is refused with WAIT for this long */
+#define SWD_WAIT_TIMEOUT_MS		500
+#define SWD_WAIT_MAX_DELAY_MS	32
+
+static struct swd_transfer *swd_queue;
+static size_t swd_queue_length;
+static size_t swd_queue_alloced;
+static int swd_queue_retval;
+
+static void swd_queue_cmd(struct adiv5_dap *dap, uint8_t cmd, uint32_t *dst, uint32_t data)
+{
+	if (swd_queue_retval != ERROR_OK)
+		return;
+
+	if (swd_queue_length == swd_queue_alloced) {
+		size_t alloced = swd_queue_alloced ? swd_queue_alloced * 2 : 64;
+		struct swd_transfer *q = realloc(swd_queue, alloced * sizeof(*swd_queue));
+		if (q == NULL) {
+			LOG_ERROR("Unable to allocate memory for the SWD queue");
+			swd_queue_retval = ERROR_FAIL;
+			return;
+		}
+		swd_queue = q;
+		swd_queue_alloced = alloced;
+	}
+
+	if (!(cmd & SWD_CMD_RnW) && !(cmd & SWD_CMD_APnDP) &&
+			(cmd & SWD_CMD_A32) >> 1 == DP_CTRL_STAT)
+		data |= CORUNDETECT;
+
+	struct swd_transfer *t = &swd_queue[swd_queue_length++];
+	t->cmd = cmd;
+	t->data = data;
+	t->dst = dst;
+}
+
+void swd_queue_read_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t *value)
+{
+	assert(cmd & SWD_CMD_RnW);
+	swd_queue_cmd(dap, cmd, value, 0);
+}
+
+void swd_queue_write_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t value)
+{
+	assert(!(cmd & SWD_CMD_RnW));
+	swd_queue_cmd(dap, cmd, NULL, value);
+}
+
+static int swd_queue_transfer(struct adiv5_dap *dap, struct swd_transfer *transfers,
+		size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		transfers[i].ack = SWD_ACK_NOT_DONE;
+
+	if (!jtag_interface->swd->transfer) {
+		LOG_ERROR("BUG: the SWD driver can't run the generic queue");
+		return ERROR_FAIL;
+	}
+
+	jtag_io_worker_wait();
+	return jtag_interface->swd->transfer(dap, transfers, count);
+}
+
+/* Clear STICKYORUN after a WAIT, so the DP accepts transactions again. */
+static int swd_queue_clear_overrun(struct adiv5_dap *dap)
+{
+	struct swd_transfer abort = {
+		.cmd = swd_cmd(false, false, DP_ABORT),
+		.data = ORUNERRCLR,
+	};
+
+	int retval = swd_queue_transfer(dap, &abort, 1);
+	if (retval == ERROR_OK && abort.ack != SWD_ACK_OK) {
+		LOG_DEBUG("SWD ABORT write not acknowledged: %d", abort.ack);
+		retval = ERROR_FAIL;
+	}
+	return retval;
+}
+
+/**
+ * Execute the queued transactions, retrying from the first one which was
+ * refused with WAIT.
+ */
+int swd_queue_run(struct adiv5_dap *dap)
+{
+	size_t start = 0;
+	size_t waiting = SIZE_MAX;
+	uint64_t delay = 0;
+	int64_t wait_start = 0;
+	int retval = swd_queue_retval;
+
+	LOG_DEBUG("Executing %zu queued transactions", swd_queue_length);
+
+	while (retval == ERROR_OK && start < swd_queue_length) {
+		retval = swd_queue_transfer(dap, swd_queue + start, swd_queue_length - start);
+		if (retval != ERROR_OK)
+			break;
+
+		size_t i;
+		for (i = start; i < swd_queue_length; i++) {
+			struct swd_transfer *t = &swd_queue[i];
+
+			LOG_DEBUG("%s %s %s reg %X = %08"PRIx32,
+					t->ack == SWD_ACK_OK ? "OK" : t->ack == SWD_ACK_WAIT ? "WAIT" :
+					t->ack == SWD_ACK_FAULT ? "FAULT" : "JUNK",
+					t->cmd & SWD_CMD_APnDP ? "AP" : "DP",
+					t->cmd & SWD_CMD_RnW ? "read" : "write",
+					(t->cmd & SWD_CMD_A32) >> 1, t->data);
+
+			if (t->ack != SWD_ACK_OK)
+				break;
+
+			if (t->cmd & SWD_CMD_RnW) {
+				if (t->parity != parity_u32(t->data)) {
+					LOG_ERROR("SWD Read data parity mismatch");
+					retval = ERROR_FAIL;
+					break;
+				}
+				if (t->dst != NULL)
+					*t->dst = t->data;
+			}
+		}
+		if (retval != ERROR_OK || i == swd_queue_length)
+			break;
+
+		if (swd_queue[i].ack != SWD_ACK_WAIT) {
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		/* Resuming at the WAIT repeats all transactions after it, so
+		 * none of them may have been performed. That's the case with
+		 * overrun detection, but it may have been lost, e.g. by a
+		 * power-on reset of the DP, so check the ACKs. */
+		for (size_t j = i + 1; j < swd_queue_length; j++) {
+			uint8_t ack = swd_queue[j].ack;
+			if (ack != SWD_ACK_NOT_DONE && ack != SWD_ACK_WAIT && ack != SWD_ACK_FAULT) {
+				LOG_DEBUG("SWD transaction %zu done after a WAIT, can't retry", j);
+				retval = ERROR_WAIT;
+				break;
+			}
+		}
+		if (retval != ERROR_OK)
+			break;
+
+		/* retry at once, then after 1, 2, 4, ... ms */
+		if (i != waiting) {
+			waiting = i;
+			wait_start = timeval_ms();
+			delay = 0;
+		} else {
+			if (timeval_ms() - wait_start > SWD_WAIT_TIMEOUT_MS) {
+				LOG_ERROR("Timeout waiting for the SWD target to accept a transaction");
+				retval = ERROR_WAIT;
+				break;
+			}
+			delay = delay ? MIN(delay * 2, SWD_WAIT_MAX_DELAY_MS) : 1;
+			alive_sleep(delay);
+		}
+
+		/* harmless if overrun detection is off */
+		retval = swd_queue_clear_overrun(dap);
+		if (retval != ERROR_OK)
+			break;
+
+		start = i;
+	}
+
+	swd_queue_length = 0;
+	swd_queue_retval = ERROR_OK;
+	return retval;
+}
@@ -38,6 +38,7 @@
 #include "interface.h"
 #include "interfaces.h"
 #include "tcl.h"
+#include "trace.h"
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -1268,6 +1269,88 @@ COMMAND_HANDLER(handle_wait_srst_deassert)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_jtag_io_worker_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		jtag_set_io_worker(enable);
+	}
+
+	command_print(CMD_CTX, "JTAG I/O worker %s",
+			jtag_get_io_worker() ? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_stats_command)
+{
+	struct cmd_queue_stats stats;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	cmd_queue_get_stats(&stats);
+
+	command_print(CMD_CTX, "queue resets: %u", stats.flushes);
+	command_print(CMD_CTX, "last queue: %zu bytes, peak queue: %zu bytes",
+			stats.last_flush_bytes, stats.peak_flush_bytes);
+	command_print(CMD_CTX, "pages held: %u (%zu bytes)",
+			stats.pages, stats.reserved_bytes);
+	command_print(CMD_CTX, "pages allocated: %u, freed: %u",
+			stats.page_allocs, stats.page_frees);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_trace_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int retval = ERROR_OK;
+	if (CMD_ARGC == 1) {
+		/* turning the I/O worker off waits for the queues it is executing,
+		 * so they are recorded completely or not at all */
+		bool io_worker = jtag_get_io_worker();
+		jtag_set_io_worker(false);
+
+		if (strcmp(CMD_ARGV[0], "off") == 0)
+			retval = jtag_trace_stop();
+		else
+			retval = jtag_trace_start(CMD_ARGV[0]);
+
+		jtag_set_io_worker(io_worker);
+	}
+
+	command_print(CMD_CTX, "adapter transaction trace %s",
+			jtag_trace_enabled() ? "enabled" : "disabled");
+
+	return retval;
+}
+
+COMMAND_HANDLER(handle_jtag_trace_replay_command)
+{
+	struct jtag_trace_replay_stats stats;
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int retval = jtag_trace_replay(CMD_ARGV[0], &stats);
+
+	command_print(CMD_CTX, "replayed %u commands (%" PRIu64 " scan bits) in %u queues, "
+			"%u records skipped", stats.commands, stats.scan_bits, stats.flushes,
+			stats.skipped);
+	command_print(CMD_CTX, "adapter time: recorded %" PRIu64 " us, replayed %" PRIu64 " us",
+			stats.recorded_us, stats.replayed_us);
+	command_print(CMD_CTX, "TDO mismatches: %u", stats.mismatches);
+
+	return retval;
+}
+
 static const struct command_registration jtag_command_handlers[] = {
 
 	{
@@ -1278,6 +1361,38 @@ static const struct command_registration jtag_command_handlers[] = {
 			"to test performance or change in behavior. Default 0ms.",
 		.usage = "[sleep in ms]",
 	},
+	{
+		.name = "jtag_io_worker",
+		.handler = handle_jtag_io_worker_command,
+		.mode = COMMAND_ANY,
+		.help = "Execute queues flushed without waiting for their "
+			"results in a separate thread, overlapping adapter I/O "
+			"with building the next queue.",
+		.usage = "['enable'|'disable']",
+	},
+	{
+		.name = "jtag_queue_stats",
+		.handler = handle_jtag_queue_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "Show memory used by the JTAG command queue.",
+		.usage = "",
+	},
+	{
+		.name = "jtag_trace",
+		.handler = handle_jtag_trace_command,
+		.mode = COMMAND_ANY,
+		.help = "Record all JTAG and SWD transactions sent to the "
+			"adapter to a binary file, or stop recording.",
+		.usage = "[filename|'off']",
+	},
+	{
+		.name = "jtag_trace_replay",
+		.handler = handle_jtag_trace_replay_command,
+		.mode = COMMAND_EXEC,
+		.help = "Replay the JTAG commands of a recorded trace through "
+			"the current adapter and compare the captured data.",
+		.usage = "filename",
+	},
 	{
 		.name = "jtag_rclk",
 		.handler = handle_jtag_rclk_command,
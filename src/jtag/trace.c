@@ -0,0 +1,609 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <jtag/jtag.h>
+#include "interface.h"
+#include "minidriver.h"
+#include "swd.h"
+#include "trace.h"
+#include <helper/time_support.h>
+
+extern struct jtag_interface *jtag_interface;
+
+#define JTAG_TRACE_MAGIC	"OCDTRACE"
+#define JTAG_TRACE_HEADER_SIZE	16
+
+/* a queued SWD transaction, recorded once the queue has run */
+struct jtag_trace_swd_op {
+	uint8_t type;
+	uint8_t cmd;
+	uint32_t data;
+	uint32_t *value;
+};
+
+static struct {
+	FILE *file;
+	int64_t start;
+	/* the adapter's SWD driver, wrapped while tracing */
+	const struct swd_driver *swd;
+	struct jtag_trace_swd_op *swd_ops;
+	unsigned swd_num_ops;
+	unsigned swd_max_ops;
+} jtag_trace;
+
+int64_t jtag_trace_time(void)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+bool jtag_trace_enabled(void)
+{
+	return jtag_trace.file != NULL;
+}
+
+static void jtag_trace_put(const void *data, size_t size)
+{
+	fwrite(data, 1, size, jtag_trace.file);
+}
+
+static void jtag_trace_put_u8(uint8_t value)
+{
+	jtag_trace_put(&value, 1);
+}
+
+static void jtag_trace_put_u32(uint32_t value)
+{
+	uint8_t buf[4];
+	h_u32_to_le(buf, value);
+	jtag_trace_put(buf, sizeof(buf));
+}
+
+static void jtag_trace_record(uint8_t type, uint32_t size, int64_t time)
+{
+	uint64_t t = time - jtag_trace.start;
+
+	jtag_trace_put_u8(type);
+	jtag_trace_put("\0\0", 3);
+	jtag_trace_put_u32(size);
+	jtag_trace_put_u32(t);
+	jtag_trace_put_u32(t >> 32);
+}
+
+static void jtag_trace_scan(struct scan_command *scan, int64_t time)
+{
+	uint32_t size = 4;
+	for (int i = 0; i < scan->num_fields; i++) {
+		struct scan_field *field = &scan->fields[i];
+		unsigned bytes = DIV_ROUND_UP(field->num_bits, 8);
+		size += 8;
+		if (field->out_value)
+			size += bytes;
+		if (field->in_value)
+			size += bytes;
+	}
+
+	jtag_trace_record(JTAG_SCAN, size, time);
+	jtag_trace_put_u8(scan->ir_scan);
+	jtag_trace_put_u8(scan->end_state);
+	jtag_trace_put_u8(scan->num_fields);
+	jtag_trace_put_u8(scan->num_fields >> 8);
+
+	for (int i = 0; i < scan->num_fields; i++) {
+		struct scan_field *field = &scan->fields[i];
+		unsigned bytes = DIV_ROUND_UP(field->num_bits, 8);
+		jtag_trace_put_u32(field->num_bits);
+		jtag_trace_put_u8((field->out_value ? 1 : 0) | (field->in_value ? 2 : 0));
+		jtag_trace_put("\0\0", 3);
+		if (field->out_value)
+			jtag_trace_put(field->out_value, bytes);
+		if (field->in_value)
+			jtag_trace_put(field->in_value, bytes);
+	}
+}
+
+void jtag_trace_queue(struct jtag_command *cmd, int64_t start, int retval)
+{
+	int64_t end = jtag_trace_time();
+
+	if (!jtag_trace.file)
+		return;
+
+	for (; cmd; cmd = cmd->next) {
+		switch (cmd->type) {
+			case JTAG_SCAN:
+				jtag_trace_scan(cmd->cmd.scan, start);
+				break;
+			case JTAG_TLR_RESET:
+				jtag_trace_record(cmd->type, 1, start);
+				jtag_trace_put_u8(cmd->cmd.statemove->end_state);
+				break;
+			case JTAG_RUNTEST:
+				jtag_trace_record(cmd->type, 5, start);
+				jtag_trace_put_u32(cmd->cmd.runtest->num_cycles);
+				jtag_trace_put_u8(cmd->cmd.runtest->end_state);
+				break;
+			case JTAG_RESET:
+				jtag_trace_record(cmd->type, 2, start);
+				jtag_trace_put_u8(cmd->cmd.reset->trst);
+				jtag_trace_put_u8(cmd->cmd.reset->srst);
+				break;
+			case JTAG_PATHMOVE:
+				jtag_trace_record(cmd->type, 4 + cmd->cmd.pathmove->num_states, start);
+				jtag_trace_put_u32(cmd->cmd.pathmove->num_states);
+				for (int i = 0; i < cmd->cmd.pathmove->num_states; i++)
+					jtag_trace_put_u8(cmd->cmd.pathmove->path[i]);
+				break;
+			case JTAG_SLEEP:
+				jtag_trace_record(cmd->type, 4, start);
+				jtag_trace_put_u32(cmd->cmd.sleep->us);
+				break;
+			case JTAG_STABLECLOCKS:
+				jtag_trace_record(cmd->type, 4, start);
+				jtag_trace_put_u32(cmd->cmd.stableclocks->num_cycles);
+				break;
+			case JTAG_TMS:
+				jtag_trace_record(cmd->type, 4 + DIV_ROUND_UP(cmd->cmd.tms->num_bits, 8), start);
+				jtag_trace_put_u32(cmd->cmd.tms->num_bits);
+				jtag_trace_put(cmd->cmd.tms->bits, DIV_ROUND_UP(cmd->cmd.tms->num_bits, 8));
+				break;
+			default:
+				break;
+		}
+	}
+
+	jtag_trace_record(JTAG_TRACE_FLUSH, 8, start);
+	jtag_trace_put_u32(retval);
+	jtag_trace_put_u32(end - start);
+}
+
+static void jtag_trace_swd_add(uint8_t type, uint8_t cmd, uint32_t data, uint32_t *value)
+{
+	if (jtag_trace.swd_num_ops == jtag_trace.swd_max_ops) {
+		unsigned max = jtag_trace.swd_max_ops ? jtag_trace.swd_max_ops * 2 : 64;
+		struct jtag_trace_swd_op *ops = realloc(jtag_trace.swd_ops, max * sizeof(*ops));
+		if (!ops)
+			return;
+		jtag_trace.swd_ops = ops;
+		jtag_trace.swd_max_ops = max;
+	}
+
+	struct jtag_trace_swd_op *op = &jtag_trace.swd_ops[jtag_trace.swd_num_ops++];
+	op->type = type;
+	op->cmd = cmd;
+	op->data = data;
+	op->value = value;
+}
+
+static int jtag_trace_swd_init(void)
+{
+	return jtag_trace.swd->init();
+}
+
+static int_least32_t jtag_trace_swd_frequency(struct adiv5_dap *dap, int_least32_t hz)
+{
+	return jtag_trace.swd->frequency(dap, hz);
+}
+
+static int jtag_trace_swd_switch_seq(struct adiv5_dap *dap, enum swd_special_seq seq)
+{
+	jtag_trace_swd_add(JTAG_TRACE_SWD_SEQ, seq, 0, NULL);
+	return jtag_trace.swd->switch_seq(dap, seq);
+}
+
+static void jtag_trace_swd_read_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t *value)
+{
+	jtag_trace_swd_add(JTAG_TRACE_SWD_READ, cmd, 0, value);
+	jtag_trace.swd->read_reg(dap, cmd, value);
+}
+
+static void jtag_trace_swd_write_reg(struct adiv5_dap *dap, uint8_t cmd, uint32_t value)
+{
+	jtag_trace_swd_add(JTAG_TRACE_SWD_WRITE, cmd, value, NULL);
+	jtag_trace.swd->write_reg(dap, cmd, value);
+}
+
+static int jtag_trace_swd_run(struct adiv5_dap *dap)
+{
+	int64_t start = jtag_trace_time();
+	int retval = jtag_trace.swd->run(dap);
+	int64_t end = jtag_trace_time();
+
+	for (unsigned i = 0; i < jtag_trace.swd_num_ops; i++) {
+		struct jtag_trace_swd_op *op = &jtag_trace.swd_ops[i];
+		if (op->type == JTAG_TRACE_SWD_SEQ) {
+			jtag_trace_record(op->type, 1, start);
+			jtag_trace_put_u8(op->cmd);
+			continue;
+		}
+		if (op->value && retval == ERROR_OK)
+			op->data = *op->value;
+		jtag_trace_record(op->type, 5, start);
+		jtag_trace_put_u8(op->cmd);
+		jtag_trace_put_u32(op->data);
+	}
+	jtag_trace.swd_num_ops = 0;
+
+	jtag_trace_record(JTAG_TRACE_SWD_RUN, 8, start);
+	jtag_trace_put_u32(retval);
+	jtag_trace_put_u32(end - start);
+
+	return retval;
+}
+
+static int *jtag_trace_swd_trace(struct adiv5_dap *dap, bool swo)
+{
+	return jtag_trace.swd->trace(dap, swo);
+}
+
+static int jtag_trace_swd_transfer(struct adiv5_dap *dap, struct swd_transfer *transfers,
+		size_t count)
+{
+	/* the transactions were recorded when they were queued */
+	return jtag_trace.swd->transfer(dap, transfers, count);
+}
+
+static struct swd_driver jtag_trace_swd = {
+	.init = jtag_trace_swd_init,
+	.frequency = jtag_trace_swd_frequency,
+	.switch_seq = jtag_trace_swd_switch_seq,
+	.read_reg = jtag_trace_swd_read_reg,
+	.write_reg = jtag_trace_swd_write_reg,
+	.run = jtag_trace_swd_run,
+};
+
+int jtag_trace_start(const char *filename)
+{
+	jtag_trace_stop();
+
+	FILE *file = fopen(filename, "wb");
+	if (!file) {
+		LOG_ERROR("couldn't open %s", filename);
+		return ERROR_FAIL;
+	}
+	setvbuf(file, NULL, _IOFBF, 1024 * 1024);
+
+	jtag_trace.file = file;
+	jtag_trace.start = jtag_trace_time();
+	jtag_trace_put(JTAG_TRACE_MAGIC, 8);
+	jtag_trace_put_u32(JTAG_TRACE_VERSION);
+
+	/* record SWD transactions by wrapping the adapter's SWD driver */
+	if (jtag_interface && jtag_interface->swd) {
+		jtag_trace.swd = jtag_interface->swd;
+		jtag_trace_swd.trace = jtag_trace.swd->trace ? jtag_trace_swd_trace : NULL;
+		jtag_trace_swd.transfer = jtag_trace.swd->transfer ? jtag_trace_swd_transfer : NULL;
+		jtag_interface->swd = &jtag_trace_swd;
+	}
+
+	return ERROR_OK;
+}
+
+int jtag_trace_stop(void)
+{
+	if (!jtag_trace.file)
+		return ERROR_OK;
+
+	if (jtag_trace.swd) {
+		jtag_interface->swd = jtag_trace.swd;
+		jtag_trace.swd = NULL;
+	}
+	free(jtag_trace.swd_ops);
+	jtag_trace.swd_ops = NULL;
+	jtag_trace.swd_num_ops = 0;
+	jtag_trace.swd_max_ops = 0;
+
+	int retval = fclose(jtag_trace.file) == 0 ? ERROR_OK : ERROR_FAIL;
+	jtag_trace.file = NULL;
+
+	return retval;
+}
+
+/* a replayed scan whose TDO is compared once its queue has run */
+struct jtag_trace_pending_scan {
+	struct jtag_trace_pending_scan *next;
+	unsigned num_bits;
+	/* captured TDO of the whole scan */
+	uint8_t *in;
+	/* recorded TDO per field: num_bits, bit offset and data */
+	unsigned num_fields;
+	struct {
+		unsigned num_bits;
+		unsigned offset;
+		const uint8_t *expected;
+	} *fields;
+	uint8_t *record;
+};
+
+static bool jtag_trace_bits_differ(const uint8_t *a, const uint8_t *b, unsigned bits)
+{
+	unsigned bytes = bits / 8;
+
+	if (memcmp(a, b, bytes) != 0)
+		return true;
+	if (bits % 8)
+		return ((a[bytes] ^ b[bytes]) & ((1 << (bits % 8)) - 1)) != 0;
+	return false;
+}
+
+static void jtag_trace_check_scans(struct jtag_trace_pending_scan **pending,
+		struct jtag_trace_replay_stats *stats, bool compare)
+{
+	while (*pending) {
+		struct jtag_trace_pending_scan *scan = *pending;
+		*pending = scan->next;
+
+		for (unsigned i = 0; compare && i < scan->num_fields; i++) {
+			unsigned bits = scan->fields[i].num_bits;
+			if (!scan->fields[i].expected)
+				continue;
+
+			uint8_t *captured = calloc(DIV_ROUND_UP(bits, 8), 1);
+			if (!captured)
+				break;
+			buf_set_buf(scan->in, scan->fields[i].offset, captured, 0, bits);
+			if (jtag_trace_bits_differ(captured, scan->fields[i].expected, bits)) {
+				if (stats->mismatches++ < 10)
+					LOG_INFO("TDO mismatch in scan of %u bits, field %u", scan->num_bits, i);
+			}
+			free(captured);
+		}
+
+		free(scan->in);
+		free(scan->fields);
+		free(scan->record);
+		free(scan);
+	}
+}
+
+/* queue a recorded scan; takes ownership of @a data */
+static int jtag_trace_replay_scan(uint8_t *data, uint32_t size,
+		struct jtag_trace_pending_scan **pending, struct jtag_trace_replay_stats *stats)
+{
+	if (size < 4) {
+		free(data);
+		return ERROR_FAIL;
+	}
+
+	bool ir_scan = data[0];
+	tap_state_t end_state = data[1];
+	unsigned num_fields = le_to_h_u16(data + 2);
+
+	struct jtag_trace_pending_scan *scan = calloc(1, sizeof(*scan));
+	if (!scan) {
+		free(data);
+		return ERROR_FAIL;
+	}
+	/* from here on, the pending list owns everything */
+	scan->next = *pending;
+	*pending = scan;
+	scan->record = data;
+	scan->num_fields = num_fields;
+	scan->fields = calloc(num_fields, sizeof(*scan->fields));
+	if (!scan->fields && num_fields)
+		return ERROR_FAIL;
+
+	/* each field has at least its 8 byte header */
+	if (num_fields > (size - 4) / 8)
+		return ERROR_FAIL;
+
+	const uint8_t **out = calloc(num_fields ? num_fields : 1, sizeof(*out));
+	if (!out)
+		return ERROR_FAIL;
+
+	/* first pass: validate and find the total length */
+	int retval = ERROR_FAIL;
+	uint8_t *tdi = NULL;
+	uint32_t pos = 4;
+	for (unsigned i = 0; i < num_fields; i++) {
+		if (size - pos < 8)
+			goto done;
+		unsigned bits = le_to_h_u32(data + pos);
+		uint8_t flags = data[pos + 4];
+		unsigned bytes = DIV_ROUND_UP(bits, 8);
+		pos += 8;
+
+		/* the scan length is passed on as an int */
+		if (bits > INT_MAX - 8 - scan->num_bits)
+			goto done;
+
+		if (flags & 1) {
+			if (size - pos < bytes)
+				goto done;
+			out[i] = data + pos;
+			pos += bytes;
+		}
+		if (flags & 2) {
+			if (size - pos < bytes)
+				goto done;
+			scan->fields[i].expected = data + pos;
+			pos += bytes;
+		}
+		scan->fields[i].num_bits = bits;
+		scan->fields[i].offset = scan->num_bits;
+		scan->num_bits += bits;
+	}
+
+	tdi = calloc(DIV_ROUND_UP(scan->num_bits, 8) + 1, 1);
+	scan->in = calloc(DIV_ROUND_UP(scan->num_bits, 8) + 1, 1);
+	if (!tdi || !scan->in)
+		goto done;
+	for (unsigned i = 0; i < num_fields; i++) {
+		if (out[i])
+			buf_set_buf(out[i], 0, tdi, scan->fields[i].offset, scan->fields[i].num_bits);
+	}
+
+	/* the queue keeps its own copy of the TDI data */
+	if (ir_scan)
+		jtag_add_plain_ir_scan(scan->num_bits, tdi, scan->in, end_state);
+	else
+		jtag_add_plain_dr_scan(scan->num_bits, tdi, scan->in, end_state);
+
+	stats->scan_bits += scan->num_bits;
+	retval = ERROR_OK;
+
+done:
+	free(tdi);
+	free(out);
+	return retval;
+}
+
+static int jtag_trace_replay_record(uint8_t type, uint8_t *data, uint32_t size,
+		struct jtag_trace_pending_scan **pending, struct jtag_trace_replay_stats *stats)
+{
+	int retval = ERROR_OK;
+
+	switch (type) {
+		case JTAG_SCAN:
+			stats->commands++;
+			return jtag_trace_replay_scan(data, size, pending, stats);
+		case JTAG_TLR_RESET:
+			jtag_add_tlr();
+			break;
+		case JTAG_RUNTEST:
+			if (size < 5)
+				retval = ERROR_FAIL;
+			else
+				jtag_add_runtest(le_to_h_u32(data), data[4]);
+			break;
+		case JTAG_RESET:
+			if (size < 2)
+				retval = ERROR_FAIL;
+			else
+				retval = interface_jtag_add_reset((int8_t)data[0], (int8_t)data[1]);
+			break;
+		case JTAG_PATHMOVE:
+			if (size < 4 || size - 4 < le_to_h_u32(data)) {
+				retval = ERROR_FAIL;
+			} else {
+				unsigned num_states = le_to_h_u32(data);
+				tap_state_t *path = malloc((num_states ? num_states : 1) * sizeof(*path));
+				if (!path) {
+					retval = ERROR_FAIL;
+					break;
+				}
+				for (unsigned i = 0; i < num_states; i++)
+					path[i] = data[4 + i];
+				jtag_add_pathmove(num_states, path);
+				free(path);
+			}
+			break;
+		case JTAG_SLEEP:
+			if (size < 4)
+				retval = ERROR_FAIL;
+			else
+				jtag_add_sleep(le_to_h_u32(data));
+			break;
+		case JTAG_STABLECLOCKS:
+			if (size < 4)
+				retval = ERROR_FAIL;
+			else
+				jtag_add_clocks(le_to_h_u32(data));
+			break;
+		case JTAG_TMS:
+			if (size < 4 || size - 4 < DIV_ROUND_UP(le_to_h_u32(data), 8))
+				retval = ERROR_FAIL;
+			else
+				retval = jtag_add_tms_seq(le_to_h_u32(data), data + 4, TAP_INVALID);
+			break;
+		case JTAG_TRACE_FLUSH:
+			if (size < 8) {
+				retval = ERROR_FAIL;
+				break;
+			}
+			{
+				int64_t start = jtag_trace_time();
+				int result = jtag_execute_queue();
+				stats->replayed_us += jtag_trace_time() - start;
+				stats->recorded_us += le_to_h_u32(data + 4);
+				stats->flushes++;
+				/* TDO is only meaningful if both runs succeeded */
+				jtag_trace_check_scans(pending, stats,
+						result == ERROR_OK && (int)le_to_h_u32(data) == ERROR_OK);
+			}
+			break;
+		case JTAG_TRACE_SWD_READ:
+		case JTAG_TRACE_SWD_WRITE:
+		case JTAG_TRACE_SWD_SEQ:
+		case JTAG_TRACE_SWD_RUN:
+			stats->skipped++;
+			break;
+		default:
+			LOG_WARNING("unknown trace record type 0x%02x", type);
+			stats->skipped++;
+			break;
+	}
+
+	if (type < JTAG_TRACE_FLUSH)
+		stats->commands++;
+	free(data);
+
+	return retval;
+}
+
+int jtag_trace_replay(const char *filename, struct jtag_trace_replay_stats *stats)
+{
+	struct jtag_trace_pending_scan *pending = NULL;
+	uint8_t header[JTAG_TRACE_HEADER_SIZE];
+	int retval = ERROR_OK;
+
+	memset(stats, 0, sizeof(*stats));
+
+	FILE *file = fopen(filename, "rb");
+	if (!file) {
+		LOG_ERROR("couldn't open %s", filename);
+		return ERROR_FAIL;
+	}
+
+	if (fread(header, 1, 12, file) != 12 ||
+			memcmp(header, JTAG_TRACE_MAGIC, 8) != 0 ||
+			le_to_h_u32(header + 8) != JTAG_TRACE_VERSION) {
+		LOG_ERROR("%s is not a trace file of version %d", filename, JTAG_TRACE_VERSION);
+		fclose(file);
+		return ERROR_FAIL;
+	}
+
+	while (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+		uint32_t size = le_to_h_u32(header + 4);
+		uint8_t *data = malloc(size ? size : 1);
+		if (!data || fread(data, 1, size, file) != size) {
+			free(data);
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		retval = jtag_trace_replay_record(header[0], data, size, &pending, stats);
+		if (retval != ERROR_OK)
+			break;
+		keep_alive();
+	}
+
+	/* commands after the last flush weren't executed when recording */
+	jtag_execute_queue();
+	jtag_trace_check_scans(&pending, stats, false);
+	fclose(file);
+
+	if (retval != ERROR_OK)
+		LOG_ERROR("malformed trace file %s", filename);
+
+	return retval;
+}
@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.           *
+ ***************************************************************************/
+
+#ifndef JTAG_TRACE_H
+#define JTAG_TRACE_H
+
+#include <jtag/commands.h>
+
+/**
+ * @file
+ * Binary recorder of the transactions sent to the debug adapter.
+ *
+ * A trace file starts with the 8 byte magic "OCDTRACE" and a little endian
+ * u32 format version. Then records follow, each with a 16 byte header:
+ * u8 type, 3 bytes padding, u32 payload length and u64 timestamp in
+ * microseconds since the trace was started, followed by the payload. All
+ * numbers are little endian; TAP states are tap_state_t values.
+ *
+ * JTAG commands are recorded after their queue was executed, so captured
+ * TDO data is included. Their record type is the jtag_command_type:
+ *
+ * - JTAG_SCAN: u8 ir_scan, u8 end_state, u16 num_fields, then for each
+ *   field u32 num_bits, u8 flags (1: TDI data follows, 2: TDO data
+ *   follows), 3 bytes padding, TDI bytes, TDO bytes.
+ * - JTAG_TLR_RESET: u8 end_state.
+ * - JTAG_RUNTEST: u32 num_cycles, u8 end_state.
+ * - JTAG_RESET: u8 trst, u8 srst (0xff: no change).
+ * - JTAG_PATHMOVE: u32 num_states, one u8 per state.
+ * - JTAG_SLEEP: u32 microseconds.
+ * - JTAG_STABLECLOCKS: u32 num_cycles.
+ * - JTAG_TMS: u32 num_bits, TMS bytes.
+ * - JTAG_TRACE_FLUSH: i32 result, u32 duration in microseconds. Ends the
+ *   commands of one executed queue; the timestamp is its start.
+ *
+ * SWD transactions are recorded when the SWD queue is run:
+ *
+ * - JTAG_TRACE_SWD_READ / JTAG_TRACE_SWD_WRITE: u8 request, u32 data.
+ * - JTAG_TRACE_SWD_SEQ: u8 enum swd_special_seq.
+ * - JTAG_TRACE_SWD_RUN: i32 result, u32 duration in microseconds.
+ */
+
+#define JTAG_TRACE_VERSION		1
+
+#define JTAG_TRACE_FLUSH		0x20
+#define JTAG_TRACE_SWD_READ		0x30
+#define JTAG_TRACE_SWD_WRITE	0x31
+#define JTAG_TRACE_SWD_SEQ		0x32
+#define JTAG_TRACE_SWD_RUN		0x33
+
+/** Start recording to @a filename, replacing any trace in progress. */
+int jtag_trace_start(const char *filename);
+/** Stop recording and close the trace file. */
+int jtag_trace_stop(void);
+/** @returns true while a trace is being recorded. */
+bool jtag_trace_enabled(void);
+
+/**
+ * Record a JTAG command queue after it was executed.
+ * @param cmd The executed queue.
+ * @param start Time the execution started, from jtag_trace_time().
+ * @param retval The result of the execution.
+ */
+void jtag_trace_queue(struct jtag_command *cmd, int64_t start, int retval);
+/** @returns the current time in microseconds, for jtag_trace_queue(). */
+int64_t jtag_trace_time(void);
+
+struct jtag_trace_replay_stats {
+	unsigned flushes;
+	unsigned commands;
+	/** SWD records, which can't be replayed */
+	unsigned skipped;
+	/** scan fields whose TDO differed from the recording */
+	unsigned mismatches;
+	uint64_t scan_bits;
+	/** adapter time of the recording and of the replay */
+	uint64_t recorded_us;
+	uint64_t replayed_us;
+};
+
+/**
+ * Replay the JTAG commands of a trace file through the current adapter,
+ * comparing captured TDO data with the recording.
+ */
+int jtag_trace_replay(const char *filename, struct jtag_trace_replay_stats *stats);
+
+#endif /* JTAG_TRACE_H */
@@ -347,6 +347,20 @@ int interface_jtag_execute_queue(void)
 	return ERROR_OK;
 }
 
+int interface_jtag_execute_queue_async(void)
+{
+	/* the FPGA already runs the queue while we keep adding to it */
+	return interface_jtag_execute_queue();
+}
+
+void interface_jtag_io_worker_wait(void)
+{
+}
+
+void interface_jtag_io_worker_stop(void)
+{
+}
+
 static void writeShiftValue(uint8_t *data, int bits);
 
 /* here we shuffle N bits out/in */
@@ -344,6 +344,8 @@ int openocd_main(int argc, char *argv[])
 
 	adapter_quit();
 
+	log_exit();
+
 	if (ERROR_FAIL == ret)
 		return EXIT_FAILURE;
 	else if (ERROR_OK != ret)
@@ -92,6 +92,7 @@ static const struct FreeRTOS_params FreeRTOS_params_list[] = {
 static int FreeRTOS_detect_rtos(struct target *target);
 static int FreeRTOS_create(struct target *target);
 static int FreeRTOS_update_threads(struct rtos *rtos);
+static int FreeRTOS_update_current_thread(struct rtos *rtos);
 static int FreeRTOS_get_thread_reg_list(struct rtos *rtos, int64_t thread_id, char **hex_reg_list);
 static int FreeRTOS_get_symbol_list_to_lookup(symbol_table_elem_t *symbol_list[]);
 
@@ -101,6 +102,7 @@ struct rtos_type FreeRTOS_rtos = {
 	.detect_rtos = FreeRTOS_detect_rtos,
 	.create = FreeRTOS_create,
 	.update_threads = FreeRTOS_update_threads,
+	.update_current_thread = FreeRTOS_update_current_thread,
 	.get_thread_reg_list = FreeRTOS_get_thread_reg_list,
 	.get_symbol_list_to_lookup = FreeRTOS_get_symbol_list_to_lookup,
 };
@@ -144,6 +146,72 @@ static const struct symbols FreeRTOS_symbol_list[] = {
 /* may be problems reading if sizes are not 32 bit long integers. */
 /* test mallocs for failure */
 
+/* Values are stored in target memory with the host's byte order, as
+ * everywhere else in this file. */
+static uint64_t FreeRTOS_get_value(const uint8_t *buf, unsigned width)
+{
+	uint64_t value = 0;
+	memcpy(&value, buf, width);
+	return value;
+}
+
+static int FreeRTOS_update_current_thread(struct rtos *rtos)
+{
+	const struct FreeRTOS_params *param;
+	int retval;
+
+	if (rtos->rtos_specific_params == NULL)
+		return -1;
+
+	param = (const struct FreeRTOS_params *) rtos->rtos_specific_params;
+
+	if (rtos->symbols == NULL) {
+		LOG_ERROR("No symbols for FreeRTOS");
+		return -3;
+	}
+
+	rtos->current_thread = 0;
+	retval = target_read_buffer(rtos->target,
+			rtos->symbols[FreeRTOS_VAL_pxCurrentTCB].address,
+			param->pointer_width,
+			(uint8_t *)&rtos->current_thread);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
+		return retval;
+	}
+	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64 "\r\n",
+										rtos->symbols[FreeRTOS_VAL_pxCurrentTCB].address,
+										rtos->current_thread);
+	return ERROR_OK;
+}
+
+#define FREERTOS_THREAD_NAME_STR_SIZE (200)
+#define FREERTOS_THREAD_NAME_CHUNK (32)
+
+/* Read a task name, in small chunks as most names are short. */
+static int FreeRTOS_read_thread_name(struct rtos *rtos, symbol_address_t address,
+		char *name)
+{
+	int offset;
+	int retval;
+
+	for (offset = 0; offset < FREERTOS_THREAD_NAME_STR_SIZE - 1;
+			offset += FREERTOS_THREAD_NAME_CHUNK) {
+		int size = FREERTOS_THREAD_NAME_STR_SIZE - 1 - offset;
+		if (size > FREERTOS_THREAD_NAME_CHUNK)
+			size = FREERTOS_THREAD_NAME_CHUNK;
+
+		retval = target_read_buffer(rtos->target, address + offset, size,
+				(uint8_t *)name + offset);
+		if (retval != ERROR_OK)
+			return retval;
+		if (memchr(name + offset, '\x00', size) != NULL)
+			break;
+	}
+	name[FREERTOS_THREAD_NAME_STR_SIZE - 1] = '\x00';
+	return ERROR_OK;
+}
+
 static int FreeRTOS_update_threads(struct rtos *rtos)
 {
 	int i = 0;
@@ -184,17 +252,9 @@ static int FreeRTOS_update_threads(struct rtos *rtos)
 	rtos_free_threadlist(rtos);
 
 	/* read the current thread */
-	retval = target_read_buffer(rtos->target,
-			rtos->symbols[FreeRTOS_VAL_pxCurrentTCB].address,
-			param->pointer_width,
-			(uint8_t *)&rtos->current_thread);
-	if (retval != ERROR_OK) {
-		LOG_ERROR("Error reading current thread in FreeRTOS thread list");
+	retval = FreeRTOS_update_current_thread(rtos);
+	if (retval != ERROR_OK)
 		return retval;
-	}
-	LOG_DEBUG("FreeRTOS: Read pxCurrentTCB at 0x%" PRIx64 ", value 0x%" PRIx64 "\r\n",
-										rtos->symbols[FreeRTOS_VAL_pxCurrentTCB].address,
-										rtos->current_thread);
 
 	if ((thread_list_size  == 0) || (rtos->current_thread == 0)) {
 		/* Either : No RTOS threads - there is always at least the current execution though */
@@ -254,8 +314,12 @@ static int FreeRTOS_update_threads(struct rtos *rtos)
 	symbol_address_t *list_of_lists =
 		malloc(sizeof(symbol_address_t) *
 			(max_used_priority+1 + 5));
-	if (!list_of_lists) {
+	/* list headers, the ready lists are read with a single access */
+	uint8_t *list_headers = malloc(param->list_width * (max_used_priority+1 + 5));
+	if (!list_of_lists || !list_headers) {
 		LOG_ERROR("Error allocating memory for %" PRId64 " priorities", max_used_priority);
+		free(list_of_lists);
+		free(list_headers);
 		return ERROR_FAIL;
 	}
 
@@ -264,82 +328,100 @@ static int FreeRTOS_update_threads(struct rtos *rtos)
 		list_of_lists[num_lists] = rtos->symbols[FreeRTOS_VAL_pxReadyTasksLists].address +
 			num_lists * param->list_width;
 
+	retval = target_read_buffer(rtos->target,
+			rtos->symbols[FreeRTOS_VAL_pxReadyTasksLists].address,
+			param->list_width * num_lists,
+			list_headers);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error reading FreeRTOS ready lists");
+		free(list_of_lists);
+		free(list_headers);
+		return retval;
+	}
+
 	list_of_lists[num_lists++] = rtos->symbols[FreeRTOS_VAL_xDelayedTaskList1].address;
 	list_of_lists[num_lists++] = rtos->symbols[FreeRTOS_VAL_xDelayedTaskList2].address;
 	list_of_lists[num_lists++] = rtos->symbols[FreeRTOS_VAL_xPendingReadyList].address;
 	list_of_lists[num_lists++] = rtos->symbols[FreeRTOS_VAL_xSuspendedTaskList].address;
 	list_of_lists[num_lists++] = rtos->symbols[FreeRTOS_VAL_xTasksWaitingTermination].address;
 
-	for (i = 0; i < num_lists; i++) {
+	for (i = max_used_priority + 1; i < num_lists; i++) {
 		if (list_of_lists[i] == 0)
 			continue;
 
-		/* Read the number of threads in this list */
-		int64_t list_thread_count = 0;
 		retval = target_read_buffer(rtos->target,
 				list_of_lists[i],
-				param->thread_count_width,
-				(uint8_t *)&list_thread_count);
+				param->list_width,
+				list_headers + i * param->list_width);
 		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading number of threads in FreeRTOS thread list");
+			LOG_ERROR("Error reading FreeRTOS thread list");
 			free(list_of_lists);
+			free(list_headers);
 			return retval;
 		}
+	}
+
+	/* the part of a list item from its next pointer up to its owner */
+	int list_elem_size = param->list_elem_content_offset + param->pointer_width -
+		param->list_elem_next_offset;
+	uint8_t list_elem[list_elem_size];
+
+	for (i = 0; i < num_lists; i++) {
+		if (list_of_lists[i] == 0)
+			continue;
+
+		/* The number of threads in this list */
+		const uint8_t *list_header = list_headers + i * param->list_width;
+		int64_t list_thread_count = FreeRTOS_get_value(list_header,
+				param->thread_count_width);
 		LOG_DEBUG("FreeRTOS: Read thread count for list %d at 0x%" PRIx64 ", value %" PRId64 "\r\n",
 										i, list_of_lists[i], list_thread_count);
 
 		if (list_thread_count == 0)
 			continue;
 
-		/* Read the location of first list item */
+		/* The location of first list item */
 		uint64_t prev_list_elem_ptr = -1;
-		uint64_t list_elem_ptr = 0;
-		retval = target_read_buffer(rtos->target,
-				list_of_lists[i] + param->list_next_offset,
-				param->pointer_width,
-				(uint8_t *)&list_elem_ptr);
-		if (retval != ERROR_OK) {
-			LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
-			free(list_of_lists);
-			return retval;
-		}
+		uint64_t list_elem_ptr = FreeRTOS_get_value(list_header + param->list_next_offset,
+				param->pointer_width);
 		LOG_DEBUG("FreeRTOS: Read first item for list %d at 0x%" PRIx64 ", value 0x%" PRIx64 "\r\n",
 										i, list_of_lists[i] + param->list_next_offset, list_elem_ptr);
 
 		while ((list_thread_count > 0) && (list_elem_ptr != 0) &&
 				(list_elem_ptr != prev_list_elem_ptr) &&
 				(tasks_found < thread_list_size)) {
-			/* Get the location of the thread structure. */
-			rtos->thread_details[tasks_found].threadid = 0;
+			/* Get the location of the thread structure and of the next
+			 * item with one access. */
 			retval = target_read_buffer(rtos->target,
-					list_elem_ptr + param->list_elem_content_offset,
-					param->pointer_width,
-					(uint8_t *)&(rtos->thread_details[tasks_found].threadid));
+					list_elem_ptr + param->list_elem_next_offset,
+					list_elem_size,
+					list_elem);
 			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading thread list item object in FreeRTOS thread list");
+				LOG_ERROR("Error reading thread list item in FreeRTOS thread list");
 				free(list_of_lists);
+				free(list_headers);
 				return retval;
 			}
+			rtos->thread_details[tasks_found].threadid = FreeRTOS_get_value(
+					list_elem + param->list_elem_content_offset - param->list_elem_next_offset,
+					param->pointer_width);
 			LOG_DEBUG("FreeRTOS: Read Thread ID at 0x%" PRIx64 ", value 0x%" PRIx64 "\r\n",
 										list_elem_ptr + param->list_elem_content_offset,
 										rtos->thread_details[tasks_found].threadid);
 
 			/* get thread name */
-
-			#define FREERTOS_THREAD_NAME_STR_SIZE (200)
 			char tmp_str[FREERTOS_THREAD_NAME_STR_SIZE];
 
 			/* Read the thread name */
-			retval = target_read_buffer(rtos->target,
+			retval = FreeRTOS_read_thread_name(rtos,
 					rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
-					FREERTOS_THREAD_NAME_STR_SIZE,
-					(uint8_t *)&tmp_str);
+					tmp_str);
 			if (retval != ERROR_OK) {
 				LOG_ERROR("Error reading first thread item location in FreeRTOS thread list");
 				free(list_of_lists);
+				free(list_headers);
 				return retval;
 			}
-			tmp_str[FREERTOS_THREAD_NAME_STR_SIZE-1] = '\x00';
 			LOG_DEBUG("FreeRTOS: Read Thread Name at 0x%" PRIx64 ", value \"%s\"\r\n",
 										rtos->thread_details[tasks_found].threadid + param->thread_name_offset,
 										tmp_str);
@@ -366,16 +448,7 @@ static int FreeRTOS_update_threads(struct rtos *rtos)
 			list_thread_count--;
 
 			prev_list_elem_ptr = list_elem_ptr;
-			list_elem_ptr = 0;
-			retval = target_read_buffer(rtos->target,
-					prev_list_elem_ptr + param->list_elem_next_offset,
-					param->pointer_width,
-					(uint8_t *)&list_elem_ptr);
-			if (retval != ERROR_OK) {
-				LOG_ERROR("Error reading next thread item location in FreeRTOS thread list");
-				free(list_of_lists);
-				return retval;
-			}
+			list_elem_ptr = FreeRTOS_get_value(list_elem, param->pointer_width);
 			LOG_DEBUG("FreeRTOS: Read next thread location at 0x%" PRIx64 ", value 0x%" PRIx64 "\r\n",
 										prev_list_elem_ptr + param->list_elem_next_offset,
 										list_elem_ptr);
@@ -383,6 +456,7 @@ static int FreeRTOS_update_threads(struct rtos *rtos)
 	}
 
 	free(list_of_lists);
+	free(list_headers);
 	rtos->thread_count = tasks_found;
 	return 0;
 }
@@ -24,6 +24,7 @@
 
 #include "rtos.h"
 #include "target/target.h"
+#include "target/register.h"
 #include "helper/log.h"
 #include "helper/binarybuffer.h"
 #include "server/gdb_server.h"
@@ -51,6 +52,11 @@ static struct rtos_type *rtos_types[] = {
 };
 
 int rtos_thread_packet(struct connection *connection, const char *packet, int packet_size);
+static void rtos_free_thread_regs(struct rtos *rtos);
+static void rtos_prefetch_thread_regs(struct rtos *rtos);
+
+/* read the register lists of all threads whenever the thread list is read */
+static bool rtos_prefetch_regs;
 
 int rtos_smp_init(struct target *target)
 {
@@ -59,6 +65,32 @@ int rtos_smp_init(struct target *target)
 	return ERROR_TARGET_INIT_FAILED;
 }
 
+/* Thread states change whenever the target runs, also when gdb doesn't see
+ * it, e.g. with "monitor step" or "monitor reset halt". Registered once
+ * for all targets, as SMP targets may share their struct rtos. */
+static int rtos_target_event_handler(struct target *target,
+		enum target_event event, void *priv)
+{
+	struct rtos *rtos = target->rtos;
+
+	if (rtos == NULL)
+		return ERROR_OK;
+
+	switch (event) {
+		case TARGET_EVENT_HALTED:
+		case TARGET_EVENT_DEBUG_HALTED:
+		case TARGET_EVENT_RESUMED:
+		case TARGET_EVENT_DEBUG_RESUMED:
+		case TARGET_EVENT_RESET_ASSERT:
+			rtos->generation++;
+			break;
+		default:
+			break;
+	}
+
+	return ERROR_OK;
+}
+
 static int os_alloc(struct target *target, struct rtos_type *ostype)
 {
 	struct rtos *os = target->rtos = calloc(1, sizeof(struct rtos));
@@ -75,6 +107,12 @@ static int os_alloc(struct target *target, struct rtos_type *ostype)
 	/* RTOS drivers can override the packet handler in _create(). */
 	os->gdb_thread_packet = rtos_thread_packet;
 
+	static bool event_handler_registered;
+	if (!event_handler_registered) {
+		target_register_event_callback(rtos_target_event_handler, NULL);
+		event_handler_registered = true;
+	}
+
 	return JIM_OK;
 }
 
@@ -86,6 +124,7 @@ static void os_free(struct target *target)
 	if (target->rtos->symbols)
 		free(target->rtos->symbols);
 
+	rtos_free_thread_regs(target->rtos);
 	free(target->rtos);
 	target->rtos = NULL;
 }
@@ -206,11 +245,22 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 	int rtos_detected = 0;
 	uint64_t addr = 0;
 	size_t reply_len;
-	char reply[GDB_BUFFER_SIZE], cur_sym[GDB_BUFFER_SIZE / 2] = "";
+	char *reply, *cur_sym;
 	symbol_table_elem_t *next_sym = NULL;
 	struct target *target = get_target_from_connection(connection);
 	struct rtos *os = target->rtos;
 
+	/* too big for the stack */
+	reply = malloc(GDB_BUFFER_SIZE);
+	cur_sym = malloc(GDB_BUFFER_SIZE / 2);
+	if (reply == NULL || cur_sym == NULL) {
+		LOG_ERROR("Out of memory");
+		free(reply);
+		free(cur_sym);
+		gdb_put_packet(connection, "E01", 3);
+		return 0;
+	}
+
 	reply_len = sprintf(reply, "OK");
 
 	if (!os)
@@ -259,24 +309,42 @@ int rtos_qsymbol(struct connection *connection, char const *packet, int packet_s
 		}
 	}
 
-	if (8 + (strlen(next_sym->symbol_name) * 2) + 1 > sizeof(reply)) {
+	if (8 + (strlen(next_sym->symbol_name) * 2) + 1 > GDB_BUFFER_SIZE) {
 		LOG_ERROR("ERROR: RTOS symbol '%s' name is too long for GDB!", next_sym->symbol_name);
 		goto done;
 	}
 
-	reply_len = snprintf(reply, sizeof(reply), "qSymbol:");
-	reply_len += hexify(reply + reply_len, next_sym->symbol_name, 0, sizeof(reply) - reply_len);
+	reply_len = snprintf(reply, GDB_BUFFER_SIZE, "qSymbol:");
+	reply_len += hexify(reply + reply_len, next_sym->symbol_name, 0, GDB_BUFFER_SIZE - reply_len);
 
 done:
 	gdb_put_packet(connection, reply, reply_len);
+	free(reply);
+	free(cur_sym);
 	return rtos_detected;
 }
 
+/* Rebuild the thread list if the target halted since it was read. */
+static void rtos_refresh_threads(struct rtos *rtos)
+{
+	if (rtos == NULL || rtos->type == NULL)
+		return;
+	if (rtos->threads_generation == rtos->generation)
+		return;
+
+	rtos->type->update_threads(rtos);
+	rtos->threads_generation = rtos->generation;
+
+	if (rtos_prefetch_regs)
+		rtos_prefetch_thread_regs(rtos);
+}
+
 int rtos_thread_packet(struct connection *connection, char const *packet, int packet_size)
 {
 	struct target *target = get_target_from_connection(connection);
 
 	if (strncmp(packet, "qThreadExtraInfo,", 17) == 0) {
+		rtos_refresh_threads(target->rtos);
 		if ((target->rtos != NULL) && (target->rtos->thread_details != NULL) &&
 				(target->rtos->thread_count != 0)) {
 			threadid_t threadid = 0;
@@ -343,11 +411,13 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 			target->rtos_auto_detect = false;
 			target->rtos->type->create(target);
 			target->rtos->type->update_threads(target->rtos);
+			target->rtos->threads_generation = target->rtos->generation;
 		}
 		return ERROR_OK;
 	} else if (strncmp(packet, "qfThreadInfo", 12) == 0) {
 		int i;
 		if (target->rtos != NULL) {
+			rtos_refresh_threads(target->rtos);
 			if (target->rtos->thread_count == 0) {
 				gdb_put_packet(connection, "l", 1);
 			} else {
@@ -392,6 +462,7 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 		threadid_t threadid;
 		int found = -1;
 		sscanf(packet, "T%" SCNx64, &threadid);
+		rtos_refresh_threads(target->rtos);
 		if ((target->rtos != NULL) && (target->rtos->thread_details != NULL)) {
 			int thread_num;
 			for (thread_num = 0; thread_num < target->rtos->thread_count; thread_num++) {
@@ -420,34 +491,139 @@ int rtos_thread_packet(struct connection *connection, char const *packet, int pa
 	return GDB_THREAD_PACKET_NOT_CONSUMED;
 }
 
-int rtos_get_gdb_reg_list(struct connection *connection)
+void rtos_set_prefetch_regs(bool enable)
 {
-	struct target *target = get_target_from_connection(connection);
+	rtos_prefetch_regs = enable;
+}
+
+static void rtos_free_thread_regs(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->thread_regs_count; i++)
+		free(rtos->thread_regs[i].hex_reg_list);
+	free(rtos->thread_regs);
+	rtos->thread_regs = NULL;
+	rtos->thread_regs_count = 0;
+}
+
+/**
+ * Get the register list of a thread that is not running. Stacked frames
+ * only change while the target runs, so the lists are kept until the next
+ * halt and repeated 'g' and 'p' packets don't read target memory again.
+ * @returns the list, owned by the cache, or NULL if it can't be read.
+ */
+static const char *rtos_thread_reg_list(struct rtos *rtos, threadid_t threadid)
+{
+	struct rtos_thread_regs *regs;
+	char *hex_reg_list = NULL;
+
+	if (rtos->thread_regs_generation != rtos->generation) {
+		rtos_free_thread_regs(rtos);
+		rtos->thread_regs_generation = rtos->generation;
+	}
+
+	for (int i = 0; i < rtos->thread_regs_count; i++) {
+		if (rtos->thread_regs[i].threadid == threadid)
+			return rtos->thread_regs[i].hex_reg_list;
+	}
+
+	rtos->type->get_thread_reg_list(rtos, threadid, &hex_reg_list);
+	if (hex_reg_list == NULL)
+		return NULL;
+
+	regs = realloc(rtos->thread_regs,
+			(rtos->thread_regs_count + 1) * sizeof(struct rtos_thread_regs));
+	if (regs == NULL) {
+		free(hex_reg_list);
+		return NULL;
+	}
+	rtos->thread_regs = regs;
+	regs[rtos->thread_regs_count].threadid = threadid;
+	regs[rtos->thread_regs_count].hex_reg_list = hex_reg_list;
+	rtos->thread_regs_count++;
+
+	return hex_reg_list;
+}
+
+/* IDEs show the frames of all threads on each stop; read them together. */
+static void rtos_prefetch_thread_regs(struct rtos *rtos)
+{
+	for (int i = 0; i < rtos->thread_count; i++) {
+		struct thread_detail *detail = &rtos->thread_details[i];
+
+		if (!detail->exists || detail->threadid == rtos->current_thread)
+			continue;
+		rtos_thread_reg_list(rtos, detail->threadid);
+	}
+}
+
+/* @returns the register list gdb gets for the selected thread, or NULL if
+ * the registers of the target itself should be used. */
+static const char *rtos_selected_reg_list(struct target *target)
+{
+	if (target->rtos == NULL)
+		return NULL;
+
 	int64_t current_threadid = target->rtos->current_threadid;
-	if ((target->rtos != NULL) && (current_threadid != -1) &&
+	if ((current_threadid != -1) &&
 			(current_threadid != 0) &&
 			((current_threadid != target->rtos->current_thread) ||
 			(target->smp))) {	/* in smp several current thread are possible */
-		char *hex_reg_list;
-
 		LOG_DEBUG("RTOS: getting register list for thread 0x%" PRIx64
 				  ", target->rtos->current_thread=0x%" PRIx64 "\r\n",
 										current_threadid,
 										target->rtos->current_thread);
 
-		target->rtos->type->get_thread_reg_list(target->rtos,
-			current_threadid,
-			&hex_reg_list);
+		return rtos_thread_reg_list(target->rtos, current_threadid);
+	}
+	return NULL;
+}
 
-		if (hex_reg_list != NULL) {
-			gdb_put_packet(connection, hex_reg_list, strlen(hex_reg_list));
-			free(hex_reg_list);
-			return ERROR_OK;
-		}
+int rtos_get_gdb_reg_list(struct connection *connection)
+{
+	struct target *target = get_target_from_connection(connection);
+	const char *hex_reg_list = rtos_selected_reg_list(target);
+
+	if (hex_reg_list != NULL) {
+		gdb_put_packet(connection, (char *)hex_reg_list, strlen(hex_reg_list));
+		return ERROR_OK;
 	}
 	return ERROR_FAIL;
 }
 
+/* The stacked register lists are laid out like the general registers of
+ * the target, so a single register can be cut out of them. */
+int rtos_get_gdb_reg(struct connection *connection, int reg_num)
+{
+	struct target *target = get_target_from_connection(connection);
+	const char *hex_reg_list = rtos_selected_reg_list(target);
+	struct reg **reg_list;
+	int reg_list_size;
+	size_t offset = 0;
+
+	if (hex_reg_list == NULL)
+		return ERROR_FAIL;
+
+	if (target_get_gdb_reg_list(target, &reg_list, &reg_list_size,
+				REG_CLASS_GENERAL) != ERROR_OK)
+		return ERROR_FAIL;
+
+	if (reg_num >= reg_list_size) {
+		free(reg_list);
+		return ERROR_FAIL;
+	}
+
+	for (int i = 0; i < reg_num; i++)
+		offset += DIV_ROUND_UP(reg_list[i]->size, 8) * 2;
+	size_t size = DIV_ROUND_UP(reg_list[reg_num]->size, 8) * 2;
+	free(reg_list);
+
+	if (offset + size > strlen(hex_reg_list))
+		return ERROR_FAIL;
+
+	gdb_put_packet(connection, (char *)hex_reg_list + offset, size);
+	return ERROR_OK;
+}
+
 int rtos_generic_stack_read(struct target *target,
 	const struct rtos_register_stacking *stacking,
 	int64_t stack_ptr,
@@ -537,8 +713,17 @@ int rtos_try_next(struct target *target)
 
 int rtos_update_threads(struct target *target)
 {
-	if ((target->rtos != NULL) && (target->rtos->type != NULL))
-		target->rtos->type->update_threads(target->rtos);
+	struct rtos *rtos = target->rtos;
+
+	if ((rtos == NULL) || (rtos->type == NULL))
+		return ERROR_OK;
+
+	/* walking every task list is slow with many threads; if the RTOS can
+	 * tell the current thread cheaply, wait until gdb asks for the list */
+	rtos->generation++;
+	if ((rtos->type->update_current_thread == NULL) ||
+			(rtos->type->update_current_thread(rtos) != ERROR_OK))
+		rtos_refresh_threads(rtos);
 	return ERROR_OK;
 }
 
@@ -46,6 +46,12 @@ struct thread_detail {
 	char *extra_info_str;
 };
 
+/* register list of a thread as sent to gdb, see rtos_thread_reg_list() */
+struct rtos_thread_regs {
+	threadid_t threadid;
+	char *hex_reg_list;
+};
+
 struct rtos {
 	const struct rtos_type *type;
 
@@ -56,6 +62,14 @@ struct rtos {
 	threadid_t current_thread;
 	struct thread_detail *thread_details;
 	int thread_count;
+	/* bumped on every halt, resume and reset; thread_details is stale
+	 * while it differs from threads_generation */
+	unsigned int generation;
+	unsigned int threads_generation;
+	/* register lists of the threads read since the last halt */
+	struct rtos_thread_regs *thread_regs;
+	int thread_regs_count;
+	unsigned int thread_regs_generation;
 	int (*gdb_thread_packet)(struct connection *connection, char const *packet, int packet_size);
 	void *rtos_specific_params;
 };
@@ -66,6 +80,9 @@ struct rtos_type {
 	int (*create)(struct target *target);
 	int (*smp_init)(struct target *target);
 	int (*update_threads)(struct rtos *rtos);
+	/* optional: only read current_thread on halt and defer
+	 * update_threads() until gdb asks for the thread list */
+	int (*update_current_thread)(struct rtos *rtos);
 	int (*get_thread_reg_list)(struct rtos *rtos, int64_t thread_id, char **hex_reg_list);
 	int (*get_symbol_list_to_lookup)(symbol_table_elem_t *symbol_list[]);
 	int (*clean)(struct target *target);
@@ -105,6 +122,8 @@ int rtos_generic_stack_read(struct target *target,
 int rtos_try_next(struct target *target);
 int gdb_thread_packet(struct connection *connection, char const *packet, int packet_size);
 int rtos_get_gdb_reg_list(struct connection *connection);
+int rtos_get_gdb_reg(struct connection *connection, int reg_num);
+void rtos_set_prefetch_regs(bool enable);
 int rtos_update_threads(struct target *target);
 void rtos_free_threadlist(struct rtos *rtos);
 int rtos_smp_init(struct target *target);
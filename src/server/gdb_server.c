@@ -90,6 +90,10 @@ struct gdb_connection {
 	 * normally we reply with a S reply via gdb_last_signal_packet.
 	 * as a side note this behaviour only effects gdb > 6.8 */
 	bool attached;
+	/* GDB announced "binary-upload+" in qSupported, so replies to the
+	 * binary memory read packet 'x' must be prefixed with 'b'. LLDB
+	 * speaks the older, unprefixed form of that packet. */
+	bool binary_upload;
 	/* temporarily used for target description support */
 	struct target_desc_format target_desc;
 };
@@ -345,8 +349,46 @@ static int gdb_write(struct connection *connection, void *data, int len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+/* Send a packet with binary payload, escaping '#', '$', '}' and '*' on
+ * the fly. The escaped data is staged through a small local buffer so
+ * the payload can be streamed without a second full-size copy. */
+static int gdb_write_binary_packet(struct connection *connection,
+		const char *buffer, int len)
+{
+	char local_buffer[1024];
+	unsigned char my_checksum = 0;
+	size_t pos = 0;
+	int retval;
+
+	local_buffer[pos++] = '$';
+
+	for (int i = 0; i < len; i++) {
+		char c = buffer[i];
+
+		if (c == '#' || c == '$' || c == '}' || c == '*') {
+			local_buffer[pos++] = '}';
+			my_checksum += '}';
+			c ^= 0x20;
+		}
+		local_buffer[pos++] = c;
+		my_checksum += c;
+
+		/* keep room for one more escaped byte and the trailing "#xx" */
+		if (pos + 6 > sizeof(local_buffer)) {
+			retval = gdb_write(connection, local_buffer, pos);
+			if (retval != ERROR_OK)
+				return retval;
+			pos = 0;
+		}
+	}
+
+	pos += snprintf(local_buffer + pos, sizeof(local_buffer) - pos, "#%02x", my_checksum);
+
+	return gdb_write(connection, local_buffer, pos);
+}
+
 static int gdb_put_packet_inner(struct connection *connection,
-		char *buffer, int len)
+		char *buffer, int len, bool binary)
 {
 	int i;
 	unsigned char my_checksum = 0;
@@ -357,8 +399,11 @@ static int gdb_put_packet_inner(struct connection *connection,
 	int retval;
 	struct gdb_connection *gdb_con = connection->priv;
 
-	for (i = 0; i < len; i++)
-		my_checksum += buffer[i];
+	/* binary packets are checksummed while escaping them */
+	if (!binary) {
+		for (i = 0; i < len; i++)
+			my_checksum += buffer[i];
+	}
 
 #ifdef _DEBUG_GDB_IO_
 	/*
@@ -396,7 +441,11 @@ static int gdb_put_packet_inner(struct connection *connection,
 
 		char local_buffer[1024];
 		local_buffer[0] = '$';
-		if ((size_t)len + 4 <= sizeof(local_buffer)) {
+		if (binary) {
+			retval = gdb_write_binary_packet(connection, buffer, len);
+			if (retval != ERROR_OK)
+				return retval;
+		} else if ((size_t)len + 4 <= sizeof(local_buffer)) {
 			/* performance gain on smaller packets by only a single call to gdb_write() */
 			memcpy(local_buffer + 1, buffer, len++);
 			len += snprintf(local_buffer + len, sizeof(local_buffer) - len, "#%02x", my_checksum);
@@ -472,7 +521,20 @@ int gdb_put_packet(struct connection *connection, char *buffer, int len)
 {
 	struct gdb_connection *gdb_con = connection->priv;
 	gdb_con->busy = 1;
-	int retval = gdb_put_packet_inner(connection, buffer, len);
+	int retval = gdb_put_packet_inner(connection, buffer, len, false);
+	gdb_con->busy = 0;
+
+	/* we sent some data, reset timer for keep alive messages */
+	kept_alive();
+
+	return retval;
+}
+
+static int gdb_put_binary_packet(struct connection *connection, char *buffer, int len)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+	gdb_con->busy = 1;
+	int retval = gdb_put_packet_inner(connection, buffer, len, true);
 	gdb_con->busy = 0;
 
 	/* we sent some data, reset timer for keep alive messages */
@@ -934,6 +996,7 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->sync = false;
 	gdb_connection->mem_write_error = false;
 	gdb_connection->attached = true;
+	gdb_connection->binary_upload = false;
 	gdb_connection->target_desc.tdesc = NULL;
 	gdb_connection->target_desc.tdesc_length = 0;
 
@@ -1257,6 +1320,9 @@ static int gdb_get_register_packet(struct connection *connection,
 	LOG_DEBUG("-");
 #endif
 
+	if ((target->rtos != NULL) && (ERROR_OK == rtos_get_gdb_reg(connection, reg_num)))
+		return ERROR_OK;
+
 	retval = target_get_gdb_reg_list(target, &reg_list, &reg_list_size,
 			REG_CLASS_ALL);
 	if (retval != ERROR_OK)
@@ -1419,6 +1485,77 @@ static int gdb_read_memory_packet(struct connection *connection,
 	return retval;
 }
 
+/* Binary variant of the 'm' packet: the reply carries the raw target
+ * memory contents (escaped), halving the bytes on the wire and saving
+ * the hex conversion. */
+static int gdb_read_memory_binary_packet(struct connection *connection,
+		char const *packet, int packet_size)
+{
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_connection *gdb_connection = connection->priv;
+	char *separator;
+	uint32_t addr = 0;
+	uint32_t len = 0;
+	int prefix_len;
+
+	char *buffer;
+
+	int retval = ERROR_OK;
+
+	/* skip command character */
+	packet++;
+
+	addr = strtoul(packet, &separator, 16);
+
+	if (*separator != ',') {
+		LOG_ERROR("incomplete read memory binary packet received, dropping connection");
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	len = strtoul(separator + 1, NULL, 16);
+
+	if (!len) {
+		/* LLDB probes for support of this packet with a zero length read */
+		gdb_put_packet(connection, "OK", 2);
+		return ERROR_OK;
+	}
+
+	/* a binary read may return fewer bytes than requested; keep the
+	 * reply within the packet size we announced */
+	if (len > GDB_BUFFER_SIZE)
+		len = GDB_BUFFER_SIZE;
+
+	/* reserve room for the 'b' prefix so the payload is sent straight from
+	 * the buffer target_read_buffer() fills */
+	prefix_len = gdb_connection->binary_upload ? 1 : 0;
+	buffer = malloc(len + prefix_len);
+	if (buffer == NULL) {
+		LOG_ERROR("unable to allocate memory read buffer");
+		return gdb_error(connection, ERROR_FAIL);
+	}
+	if (prefix_len)
+		buffer[0] = 'b';
+
+	LOG_DEBUG("addr: 0x%8.8" PRIx32 ", len: 0x%8.8" PRIx32 "", addr, len);
+
+	retval = target_read_buffer(target, addr, len, (uint8_t *)buffer + prefix_len);
+
+	if ((retval != ERROR_OK) && !gdb_report_data_abort) {
+		/* same as gdb_read_memory_packet(), send back all zero's */
+		memset(buffer + prefix_len, 0, len);
+		retval = ERROR_OK;
+	}
+
+	if (retval == ERROR_OK)
+		gdb_put_binary_packet(connection, buffer, len + prefix_len);
+	else
+		retval = gdb_error(connection, retval);
+
+	free(buffer);
+
+	return retval;
+}
+
 static int gdb_write_memory_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -2339,6 +2476,9 @@ static int gdb_query_packet(struct connection *connection,
 		int size = 0;
 		int gdb_target_desc_supported = 0;
 
+		/* GDB only accepts 'b' prefixed 'x' replies, LLDB only unprefixed ones */
+		gdb_connection->binary_upload = strstr(packet, "binary-upload+") != NULL;
+
 		/* we need to test that the target supports target descriptions */
 		retval = gdb_target_description_supported(target, &gdb_target_desc_supported);
 		if (retval != ERROR_OK) {
@@ -2357,7 +2497,8 @@ static int gdb_query_packet(struct connection *connection,
 			&buffer,
 			&pos,
 			&size,
-			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;QStartNoAckMode+",
+			"PacketSize=%x;qXfer:memory-map:read%c;qXfer:features:read%c;"
+			"QStartNoAckMode+;binary-upload+",
 			(GDB_BUFFER_SIZE - 1),
 			((gdb_use_memory_map == 1) && (flash_get_bank_count() > 0)) ? '+' : '-',
 			(gdb_target_desc_supported == 1) ? '+' : '-');
@@ -2707,6 +2848,9 @@ static int gdb_input_inner(struct connection *connection)
 				case 'M':
 					retval = gdb_write_memory_packet(connection, packet, packet_size);
 					break;
+				case 'x':
+					retval = gdb_read_memory_binary_packet(connection, packet, packet_size);
+					break;
 				case 'z':
 				case 'Z':
 					retval = gdb_breakpoint_watchpoint_packet(connection, packet, packet_size);
@@ -3016,6 +3160,18 @@ COMMAND_HANDLER(handle_gdb_report_data_abort_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_gdb_rtos_prefetch_regs_command)
+{
+	bool gdb_rtos_prefetch_regs;
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ENABLE(CMD_ARGV[0], gdb_rtos_prefetch_regs);
+	rtos_set_prefetch_regs(gdb_rtos_prefetch_regs);
+	return ERROR_OK;
+}
+
 /* gdb_breakpoint_override */
 COMMAND_HANDLER(handle_gdb_breakpoint_override_command)
 {
@@ -3137,6 +3293,14 @@ static const struct command_registration gdb_command_handlers[] = {
 		.help = "enable or disable reporting data aborts",
 		.usage = "('enable'|'disable')"
 	},
+	{
+		.name = "gdb_rtos_prefetch_regs",
+		.handler = handle_gdb_rtos_prefetch_regs_command,
+		.mode = COMMAND_ANY,
+		.help = "enable or disable reading the registers of all RTOS "
+			"threads together with the thread list",
+		.usage = "('enable'|'disable')"
+	},
 	{
 		.name = "gdb_breakpoint_override",
 		.handler = handle_gdb_breakpoint_override_command,
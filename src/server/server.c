@@ -42,6 +42,17 @@
 #include <netinet/tcp.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+
+/* maximum number of ready fds fetched per epoll_wait() */
+#define SERVER_EPOLL_EVENTS 32
+
+/* epoll instance watching all service and connection fds, -1 while
+ * server_loop() uses (or has fallen back to) select() */
+static int server_epoll_fd = -1;
+#endif
+
 static struct service *services;
 
 /* shutdown_openocd == 1: exit the main event loop, and quit the
@@ -54,6 +65,69 @@ static int last_signal;
 /* set the polling period to 100ms */
 static int polling_period = 100;
 
+static void server_epoll_disable(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (server_epoll_fd != -1) {
+		close(server_epoll_fd);
+		server_epoll_fd = -1;
+	}
+#endif
+}
+
+/* Register @a fd with the epoll instance; @a ready is the flag
+ * server_loop() sets when the fd becomes readable. */
+static void server_watch_fd(int fd, bool *ready)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event ev;
+
+	if (server_epoll_fd == -1 || fd == -1)
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = ready;
+	if (epoll_ctl(server_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+		/* e.g. stdin redirected from a regular file */
+		LOG_DEBUG("cannot watch fd %d with epoll (%s), using select()",
+			fd, strerror(errno));
+		server_epoll_disable();
+	}
+#endif
+}
+
+static void server_unwatch_fd(int fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	/* the event argument is ignored but must be non-NULL on old kernels */
+	struct epoll_event ev;
+
+	if (server_epoll_fd == -1 || fd == -1)
+		return;
+
+	memset(&ev, 0, sizeof(ev));
+	epoll_ctl(server_epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+#endif
+}
+
+static void server_epoll_init(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	server_epoll_fd = epoll_create(SERVER_EPOLL_EVENTS);
+	if (server_epoll_fd == -1) {
+		LOG_DEBUG("epoll_create failed: %s", strerror(errno));
+		return;
+	}
+
+	for (struct service *service = services; service; service = service->next) {
+		server_watch_fd(service->fd, &service->fd_ready);
+		for (struct connection *c = service->connections; c; c = c->next)
+			server_watch_fd(c->fd, &c->fd_ready);
+	}
+#endif
+}
+
 static int add_connection(struct service *service, struct command_context *cmd_ctx)
 {
 	socklen_t address_size;
@@ -68,6 +142,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	c->cmd_ctx = copy_command_context(cmd_ctx);
 	c->service = service;
 	c->input_pending = 0;
+	c->fd_ready = false;
 	c->priv = NULL;
 	c->next = NULL;
 
@@ -107,6 +182,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 #endif
 
 		/* do not check for new connections again on stdin */
+		server_unwatch_fd(service->fd);
 		service->fd = -1;
 
 		LOG_INFO("accepting '%s' connection from pipe", service->name);
@@ -120,6 +196,7 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	} else if (service->type == CONNECTION_PIPE) {
 		c->fd = service->fd;
 		/* do not check for new connections again on stdin */
+		server_unwatch_fd(service->fd);
 		service->fd = -1;
 
 		char *out_file = alloc_printf("%so", service->port);
@@ -145,6 +222,8 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 		;
 	*p = c;
 
+	server_watch_fd(c->fd, &c->fd_ready);
+
 	if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 		service->max_connections--;
 
@@ -160,11 +239,13 @@ static int remove_connection(struct service *service, struct connection *connect
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
 			service->connection_closed(c);
+			server_unwatch_fd(c->fd);
 			if (service->type == CONNECTION_TCP)
 				close_socket(c->fd);
 			else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
+				server_watch_fd(c->service->fd, &c->service->fd_ready);
 			}
 
 			command_done(c->cmd_ctx);
@@ -204,6 +285,7 @@ int add_service(char *name,
 	c->port = strdup(port);
 	c->max_connections = 1;	/* Only TCP/IP ports can support more than one connection */
 	c->fd = -1;
+	c->fd_ready = false;
 	c->connections = NULL;
 	c->new_connection = new_connection_handler;
 	c->input = input_handler;
@@ -302,6 +384,8 @@ int add_service(char *name,
 		;
 	*p = c;
 
+	server_watch_fd(c->fd, &c->fd_ready);
+
 	return ERROR_OK;
 }
 
@@ -338,16 +422,105 @@ static int remove_services(void)
 	return ERROR_OK;
 }
 
+/* Wait up to @a timeout_ms for activity using select(), flagging every
+ * readable service and connection. */
+static int server_wait_select(int timeout_ms)
+{
+	struct service *service;
+	struct connection *c;
+	fd_set read_fds;
+	int fd_max = 0;
+	int retval;
+
+	FD_ZERO(&read_fds);
+
+	/* add service and connection fds to read_fds */
+	for (service = services; service; service = service->next) {
+		if (service->fd != -1) {
+			/* listen for new connections */
+			FD_SET(service->fd, &read_fds);
+
+			if (service->fd > fd_max)
+				fd_max = service->fd;
+		}
+
+		for (c = service->connections; c; c = c->next) {
+			/* check for activity on the connection */
+			FD_SET(c->fd, &read_fds);
+			if (c->fd > fd_max)
+				fd_max = c->fd;
+		}
+	}
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+
+	if (retval == -1) {
+#ifdef _WIN32
+		errno = WSAGetLastError();
+
+		if (errno == WSAEINTR)
+			return 0;
+#else
+		if (errno == EINTR)
+			return 0;
+#endif
+		LOG_ERROR("error during select: %s", strerror(errno));
+		exit(-1);
+	}
+
+	/* eCos leaves read_fds unchanged on timeout! */
+	if (retval == 0)
+		return 0;
+
+	for (service = services; service; service = service->next) {
+		if (service->fd != -1 && FD_ISSET(service->fd, &read_fds))
+			service->fd_ready = true;
+
+		for (c = service->connections; c; c = c->next) {
+			if (FD_ISSET(c->fd, &read_fds))
+				c->fd_ready = true;
+		}
+	}
+
+	return retval;
+}
+
+/* Wait up to @a timeout_ms for activity, flagging every readable service
+ * and connection. Returns the number of ready fds, 0 on timeout. */
+static int server_wait(int timeout_ms)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (server_epoll_fd != -1) {
+		struct epoll_event events[SERVER_EPOLL_EVENTS];
+		int retval;
+
+		retval = epoll_wait(server_epoll_fd, events, SERVER_EPOLL_EVENTS, timeout_ms);
+		if (retval == -1) {
+			if (errno == EINTR)
+				return 0;
+			LOG_ERROR("error during epoll_wait: %s", strerror(errno));
+			exit(-1);
+		}
+
+		for (int i = 0; i < retval; i++)
+			*(bool *)events[i].data.ptr = true;
+
+		return retval;
+	}
+#endif
+
+	return server_wait_select(timeout_ms);
+}
+
 int server_loop(struct command_context *command_context)
 {
 	struct service *service;
 
 	bool poll_ok = true;
 
-	/* used in select() */
-	fd_set read_fds;
-	int fd_max;
-
 	/* used in accept() */
 	int retval;
 
@@ -356,80 +529,34 @@ int server_loop(struct command_context *command_context)
 		LOG_ERROR("couldn't set SIGPIPE to SIG_IGN");
 #endif
 
-	while (!shutdown_openocd) {
-		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
-
-		/* add service and connection fds to read_fds */
-		for (service = services; service; service = service->next) {
-			if (service->fd != -1) {
-				/* listen for new connections */
-				FD_SET(service->fd, &read_fds);
+	server_epoll_init();
 
-				if (service->fd > fd_max)
-					fd_max = service->fd;
-			}
-
-			if (service->connections) {
-				struct connection *c;
-
-				for (c = service->connections; c; c = c->next) {
-					/* check for activity on the connection */
-					FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
-				}
-			}
-		}
-
-		struct timeval tv;
-		tv.tv_sec = 0;
+	while (!shutdown_openocd) {
 		if (poll_ok) {
 			/* we're just polling this iteration, this is faster on embedded
 			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait(0);
 		} else {
-			/* Every 100ms, can be changed with "poll_period" command */
-			tv.tv_usec = polling_period * 1000;
+			/* Sleep until the next timer callback is due, but at most
+			 * 100ms, can be changed with "poll_period" command */
+			int timeout_ms = polling_period;
+			int next_timer_ms = target_timer_next_due_ms();
+			if (next_timer_ms >= 0 && next_timer_ms < timeout_ms)
+				timeout_ms = next_timer_ms;
+
 			/* Only while we're sleeping we'll let others run */
 			openocd_sleep_prelude();
 			kept_alive();
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait(timeout_ms);
 			openocd_sleep_postlude();
 		}
 
-		if (retval == -1) {
-#ifdef _WIN32
-
-			errno = WSAGetLastError();
-
-			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
-			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
-				exit(-1);
-			}
-#else
-
-			if (errno == EINTR)
-				FD_ZERO(&read_fds);
-			else {
-				LOG_ERROR("error during select: %s", strerror(errno));
-				exit(-1);
-			}
-#endif
-		}
-
 		if (retval == 0) {
 			/* We only execute these callbacks when there was nothing to do or we timed
 			 *out */
 			target_call_timer_callbacks();
 			process_jim_events(command_context);
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
-
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
 			poll_ok = false;
@@ -447,8 +574,8 @@ int server_loop(struct command_context *command_context)
 
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
-			if ((service->fd != -1)
-			    && (FD_ISSET(service->fd, &read_fds))) {
+			if ((service->fd != -1) && service->fd_ready) {
+				service->fd_ready = false;
 				if (service->max_connections != 0)
 					add_connection(service, command_context);
 				else {
@@ -472,7 +599,8 @@ int server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					if (c->fd_ready || c->input_pending) {
+						c->fd_ready = false;
 						retval = service->input(c);
 						if (retval != ERROR_OK) {
 							struct connection *next = c->next;
@@ -503,6 +631,8 @@ int server_loop(struct command_context *command_context)
 #endif
 	}
 
+	server_epoll_disable();
+
 	return shutdown_openocd != 2 ? ERROR_OK : ERROR_FAIL;
 }
 
@@ -48,6 +48,7 @@ struct connection {
 	struct command_context *cmd_ctx;
 	struct service *service;
 	int input_pending;
+	bool fd_ready;	/* set by server_loop() when fd has data to read */
 	void *priv;
 	struct connection *next;
 };
@@ -62,6 +63,7 @@ struct service {
 	char *port;
 	unsigned short portnumber;
 	int fd;
+	bool fd_ready;	/* set by server_loop() when fd has a pending accept */
 	struct sockaddr_in sin;
 	int max_connections;
 	struct connection *connections;
@@ -110,6 +110,7 @@ static int swd_connect(struct adiv5_dap *dap)
 	 */
 
 	/* Note, debugport_init() does setup too */
+	jtag_io_worker_wait();
 	jtag_interface->swd->switch_seq(dap, JTAG_TO_SWD);
 
 	dap->do_reconnect = false;
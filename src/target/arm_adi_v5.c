@@ -108,16 +108,54 @@ void dap_ap_select(struct adiv5_dap *dap, uint8_t ap)
 	uint32_t new_ap = (ap << 24) & 0xFF000000;
 
 	if (new_ap != dap->ap_current) {
+		/* Keep CSW and TAR of the AP left, they are still set when
+		 * switching back to it. ap_current is invalid before the
+		 * first selection. */
+		if ((dap->ap_current & 0x00FFFFFF) == 0) {
+			dap->ap_csw_cache[dap->ap_current >> 24] = dap->ap_csw_value;
+			dap->ap_tar_cache[dap->ap_current >> 24] = dap->ap_tar_value;
+		}
+
 		dap->ap_current = new_ap;
-		/* Switching AP invalidates cached values.
-		 * Values MUST BE UPDATED BEFORE AP ACCESS.
+		/* Switching AP changes the SELECT register, which MUST BE
+		 * UPDATED BEFORE AP ACCESS.
 		 */
 		dap->ap_bank_value = -1;
-		dap->ap_csw_value = -1;
-		dap->ap_tar_value = -1;
+		dap->ap_csw_value = dap->ap_csw_cache[ap];
+		dap->ap_tar_value = dap->ap_tar_cache[ap];
 	}
 }
 
+/**
+ * Forget the cached SELECT, CSW and TAR values of all APs, so they are
+ * written before they are used next.
+ *
+ * @param dap The DAP
+ */
+void dap_invalidate_cache(struct adiv5_dap *dap)
+{
+	dap->ap_bank_value = -1;
+	dap->ap_csw_value = -1;
+	dap->ap_tar_value = -1;
+	for (size_t i = 0; i < ARRAY_SIZE(dap->ap_csw_cache); i++) {
+		dap->ap_csw_cache[i] = -1;
+		dap->ap_tar_cache[i] = -1;
+	}
+}
+
+/**
+ * Free the memory a DAP allocated for its own use. Called by the target
+ * which owns the DAP when it is torn down.
+ *
+ * @param dap The DAP
+ */
+void dap_deinit(struct adiv5_dap *dap)
+{
+	free(dap->read_buf);
+	dap->read_buf = NULL;
+	dap->read_buf_words = 0;
+}
+
 static int dap_setup_accessport_csw(struct adiv5_dap *dap, uint32_t csw)
 {
 	csw = csw | CSW_DBGSWENABLE | CSW_MASTER_DEBUG | CSW_HPROT |
@@ -277,6 +315,109 @@ int mem_ap_write_atomic_u32(struct adiv5_dap *dap, uint32_t address,
 	return dap_run(dap);
 }
 
+/**
+ * Find the TAR autoincrement block size of the currently selected MEM-AP
+ * by letting TAR roll over.
+ *
+ * The last word of the ROM table, its CID3 register, is read with TAR
+ * autoincrement on, which is safe on any MEM-AP that has a ROM table.
+ * The next address is 4 KiB aligned at least. If TAR wrapped, the
+ * distance it went back is the block size; if it didn't, the block is
+ * larger than the alignment of that address.
+ *
+ * @param dap The DAP connected to the MEM-AP.
+ * @param block Set to the block size, or to 0 if the AP has no ROM table
+ *	or TAR didn't behave as expected.
+ * @return ERROR_OK on success, else a fault code.
+ */
+static int mem_ap_probe_tar_autoincr(struct adiv5_dap *dap, uint32_t *block)
+{
+	uint32_t base, cid3, tar;
+	int retval;
+
+	*block = 0;
+
+	retval = dap_queue_ap_read(dap, AP_REG_BASE, &base);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = dap_run(dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* Legacy format without debug entry, or ADIv5 format with the
+	 * entry marked not present */
+	if (base == 0xFFFFFFFF || (base & 0x3) == 0x2)
+		return ERROR_OK;
+
+	uint32_t next = (base & 0xFFFFF000) + 0x1000;
+	if (next == 0)
+		return ERROR_OK;
+
+	retval = dap_setup_accessport(dap, CSW_32BIT | CSW_ADDRINC_SINGLE, next - 4);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = dap_queue_ap_read(dap, AP_REG_DRW, &cid3);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = dap_queue_ap_read(dap, AP_REG_TAR, &tar);
+	if (retval != ERROR_OK)
+		return retval;
+	retval = dap_run(dap);
+	/* TAR has moved on from the cached value */
+	dap->ap_tar_value = -1;
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t align = next & -next;
+	if (tar == next) {
+		*block = align < 0x80000000 ? align << 1 : align;
+	} else {
+		uint32_t wrap = next - tar;
+		/* a power of two, at least 10 bits, that divides next */
+		if ((wrap & (wrap - 1)) == 0 && wrap >= (1 << 10) && wrap <= align)
+			*block = wrap;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Get the TAR autoincrement block size of the currently selected MEM-AP,
+ * probing it on the first call for each AP. If the probe fails, e.g.
+ * because the ROM table is powered down or secure, the AP falls back to
+ * dap->tar_autoincr_block for good.
+ */
+static uint32_t mem_ap_tar_autoincr_block(struct adiv5_dap *dap)
+{
+	uint8_t ap = dap->ap_current >> 24;
+
+	if (!dap->ap_tar_autoincr_probed[ap]) {
+		int retval = mem_ap_probe_tar_autoincr(dap, &dap->ap_tar_autoincr_block[ap]);
+		if (retval != ERROR_OK) {
+			LOG_DEBUG("AP %" PRIu8 " TAR autoincrement probe failed", ap);
+			dap->ap_tar_autoincr_block[ap] = 0;
+			/* the probe may have left CSW and TAR anywhere */
+			dap->ap_csw_value = -1;
+			dap->ap_tar_value = -1;
+			/* clear the sticky error, so the caller's access can go on */
+			if (dap_queue_ap_abort(dap, NULL) == ERROR_OK)
+				dap_run(dap);
+		}
+		dap->ap_tar_autoincr_probed[ap] = true;
+
+		if (dap->ap_tar_autoincr_block[ap])
+			LOG_DEBUG("AP %" PRIu8 " TAR autoincrement block: %" PRIu32,
+					ap, dap->ap_tar_autoincr_block[ap]);
+		else
+			LOG_DEBUG("AP %" PRIu8 " TAR autoincrement block unknown, using %" PRIu32,
+					ap, dap->tar_autoincr_block);
+	}
+
+	if (dap->ap_tar_autoincr_block[ap] == 0)
+		return dap->tar_autoincr_block;
+	return dap->ap_tar_autoincr_block[ap];
+}
+
 /**
  * Synchronous write of a block of memory, using a specific access size.
  *
@@ -327,6 +468,8 @@ int mem_ap_write(struct adiv5_dap *dap, const uint8_t *buffer, uint32_t size, ui
 	if (dap->unaligned_access_bad && (address % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
+	uint32_t tar_autoincr_block = mem_ap_tar_autoincr_block(dap);
+
 	retval = dap_setup_accessport_tar(dap, address ^ addr_xor);
 	if (retval != ERROR_OK)
 		return retval;
@@ -336,7 +479,7 @@ int mem_ap_write(struct adiv5_dap *dap, const uint8_t *buffer, uint32_t size, ui
 
 		/* Select packed transfer if possible */
 		if (addrinc && dap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(dap->tar_autoincr_block, address) >= 4) {
+				&& max_tar_block_size(tar_autoincr_block, address) >= 4) {
 			this_size = 4;
 			retval = dap_setup_accessport_csw(dap, csw_size | CSW_ADDRINC_PACKED);
 		} else {
@@ -384,7 +527,7 @@ int mem_ap_write(struct adiv5_dap *dap, const uint8_t *buffer, uint32_t size, ui
 			break;
 
 		/* Rewrite TAR if it wrapped or we're xoring addresses */
-		if (addrinc && (addr_xor || (address % dap->tar_autoincr_block < size && nbytes > 0))) {
+		if (addrinc && (addr_xor || (address % tar_autoincr_block < size && nbytes > 0))) {
 			retval = dap_setup_accessport_tar(dap, address ^ addr_xor);
 			if (retval != ERROR_OK)
 				break;
@@ -407,6 +550,27 @@ int mem_ap_write(struct adiv5_dap *dap, const uint8_t *buffer, uint32_t size, ui
 	return retval;
 }
 
+/* @returns true if the DRW read at @a address transfers a packed word */
+static inline bool mem_ap_read_packed(struct adiv5_dap *dap, uint32_t tar_autoincr_block,
+		uint32_t address, size_t nbytes, bool addrinc)
+{
+	return addrinc && dap->packed_transfers && nbytes >= 4
+		&& max_tar_block_size(tar_autoincr_block, address) >= 4;
+}
+
+/* Get room for @a words DRW words in the scratch buffer of the DAP. */
+static uint32_t *dap_get_read_buf(struct adiv5_dap *dap, size_t words)
+{
+	if (words > dap->read_buf_words) {
+		uint32_t *read_buf = realloc(dap->read_buf, words * sizeof(uint32_t));
+		if (read_buf == NULL)
+			return NULL;
+		dap->read_buf = read_buf;
+		dap->read_buf_words = words;
+	}
+	return dap->read_buf;
+}
+
 /**
  * Synchronous read of a block of memory, using a specific access size.
  *
@@ -447,21 +611,42 @@ int mem_ap_read(struct adiv5_dap *dap, uint8_t *buffer, uint32_t size, uint32_t
 	if (dap->unaligned_access_bad && (adr % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	/* Allocate buffer to hold the sequence of DRW reads that will be made. This is a significant
-	 * over-allocation if packed transfers are going to be used, but determining the real need at
-	 * this point would be messy. */
-	uint32_t *read_buf = malloc(count * sizeof(uint32_t));
-	uint32_t *read_ptr = read_buf;
-	if (read_buf == NULL) {
-		LOG_ERROR("Failed to allocate read buffer");
-		return ERROR_FAIL;
+	uint32_t tar_autoincr_block = mem_ap_tar_autoincr_block(dap);
+
+	/* Aligned word reads fill every byte of the caller's buffer in order, so
+	 * the DRW words can be stored there directly and converted in place.
+	 * Otherwise they go to the scratch buffer of the DAP, sized for the
+	 * number of DRW reads that will be made. */
+	bool direct = size == 4 && adr % 4 == 0 && !dap->ti_be_32_quirks
+		&& (uintptr_t)buffer % sizeof(uint32_t) == 0;
+	uint32_t *read_buf;
+
+	if (direct) {
+		read_buf = (uint32_t *)buffer;
+	} else {
+		size_t words = 0;
+		while (nbytes > 0) {
+			uint32_t this_size = size;
+			if (mem_ap_read_packed(dap, tar_autoincr_block, address, nbytes, addrinc))
+				this_size = 4;
+			nbytes -= this_size;
+			address += this_size;
+			words++;
+		}
+		nbytes = size * count;
+		address = adr;
+
+		read_buf = dap_get_read_buf(dap, words);
+		if (read_buf == NULL) {
+			LOG_ERROR("Failed to allocate read buffer");
+			return ERROR_FAIL;
+		}
 	}
+	uint32_t *read_ptr = read_buf;
 
 	retval = dap_setup_accessport_tar(dap, address);
-	if (retval != ERROR_OK) {
-		free(read_buf);
+	if (retval != ERROR_OK)
 		return retval;
-	}
 
 	/* Queue up all reads. Each read will store the entire DRW word in the read buffer. How many
 	 * useful bytes it contains, and their location in the word, depends on the type of transfer
@@ -470,8 +655,7 @@ int mem_ap_read(struct adiv5_dap *dap, uint8_t *buffer, uint32_t size, uint32_t
 		uint32_t this_size = size;
 
 		/* Select packed transfer if possible */
-		if (addrinc && dap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(dap->tar_autoincr_block, address) >= 4) {
+		if (mem_ap_read_packed(dap, tar_autoincr_block, address, nbytes, addrinc)) {
 			this_size = 4;
 			retval = dap_setup_accessport_csw(dap, csw_size | CSW_ADDRINC_PACKED);
 		} else {
@@ -488,7 +672,7 @@ int mem_ap_read(struct adiv5_dap *dap, uint8_t *buffer, uint32_t size, uint32_t
 		address += this_size;
 
 		/* Rewrite TAR if it wrapped */
-		if (addrinc && address % dap->tar_autoincr_block < size && nbytes > 0) {
+		if (addrinc && address % tar_autoincr_block < size && nbytes > 0) {
 			retval = dap_setup_accessport_tar(dap, address);
 			if (retval != ERROR_OK)
 				break;
@@ -518,14 +702,19 @@ int mem_ap_read(struct adiv5_dap *dap, uint8_t *buffer, uint32_t size, uint32_t
 		}
 	}
 
+	if (direct) {
+		/* a no-op on little endian hosts */
+		for (size_t i = 0; i < nbytes / 4; i++)
+			h_u32_to_le(buffer + 4 * i, read_buf[i]);
+		return retval;
+	}
+
 	/* Replay loop to populate caller's buffer from the correct word and byte lane */
 	while (nbytes > 0) {
 		uint32_t this_size = size;
 
-		if (addrinc && dap->packed_transfers && nbytes >= 4
-				&& max_tar_block_size(dap->tar_autoincr_block, address) >= 4) {
+		if (mem_ap_read_packed(dap, tar_autoincr_block, address, nbytes, addrinc))
 			this_size = 4;
-		}
 
 		if (dap->ti_be_32_quirks) {
 			switch (this_size) {
@@ -537,6 +726,11 @@ int mem_ap_read(struct adiv5_dap *dap, uint8_t *buffer, uint32_t size, uint32_t
 			case 1:
 				*buffer++ = *read_ptr >> 8 * (3 - (address++ & 3));
 			}
+		} else if (this_size == 4 && (address & 3) == 0) {
+			/* all four byte lanes, in order */
+			h_u32_to_le(buffer, *read_ptr);
+			buffer += 4;
+			address += 4;
 		} else {
 			switch (this_size) {
 			case 4:
@@ -553,7 +747,6 @@ int mem_ap_read(struct adiv5_dap *dap, uint8_t *buffer, uint32_t size, uint32_t
 		nbytes -= this_size;
 	}
 
-	free(read_buf);
 	return retval;
 }
 
@@ -662,6 +855,8 @@ int ahbap_debugport_init(struct adiv5_dap *dap)
 	 * Presumably we can ignore the possibility of multiple APs.
 	 */
 	dap->ap_current = !0;
+	dap_invalidate_cache(dap);
+	memset(dap->ap_tar_autoincr_probed, 0, sizeof(dap->ap_tar_autoincr_probed));
 	dap_ap_select(dap, 0);
 	dap->last_read = NULL;
 
@@ -184,6 +184,15 @@ struct adiv5_dap {
 	 */
 	uint32_t ap_tar_value;
 
+	/**
+	 * CSW and TAR values of the APs which are not selected. Each AP keeps
+	 * its registers while another one is used, so ap_csw_value and
+	 * ap_tar_value are saved here by dap_ap_select() and restored when the
+	 * AP is selected again. "-1" indicates no cached value.
+	 */
+	uint32_t ap_csw_cache[256];
+	uint32_t ap_tar_cache[256];
+
 	/* information about current pending SWjDP-AHBAP transaction */
 	uint8_t  ack;
 
@@ -193,15 +202,31 @@ struct adiv5_dap {
 	 */
 	uint32_t *last_read;
 
+	/**
+	 * Scratch space for the DRW words of mem_ap_read(), kept between
+	 * calls so large reads don't allocate every time.
+	 */
+	uint32_t *read_buf;
+	size_t read_buf_words;
+
 	/**
 	 * Configures how many extra tck clocks are added after starting a
 	 * MEM-AP access before we try to read its status (and/or result).
 	 */
 	uint32_t	memaccess_tck;
 
-	/* Size of TAR autoincrement block, ARM ADI Specification requires at least 10 bits */
+	/* Size of TAR autoincrement block, ARM ADI Specification requires at least 10 bits.
+	 * Used for the APs whose block size could not be probed. */
 	uint32_t tar_autoincr_block;
 
+	/**
+	 * TAR autoincrement block size of each AP, found by
+	 * mem_ap_probe_tar_autoincr() on its first memory access.
+	 * 0 if the probe could not tell.
+	 */
+	uint32_t ap_tar_autoincr_block[256];
+	bool ap_tar_autoincr_probed[256];
+
 	/* true if packed transfers are supported by the MEM-AP */
 	bool packed_transfers;
 
@@ -351,6 +376,9 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 	return dap->ops->queue_ap_abort(dap, ack);
 }
 
+void dap_invalidate_cache(struct adiv5_dap *dap);
+void dap_deinit(struct adiv5_dap *dap);
+
 /**
  * Perform all queued DAP operations, and clear any errors posted in the
  * CTRL_STAT register when they are done.  Note that if more than one AP
@@ -364,7 +392,12 @@ static inline int dap_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
 static inline int dap_run(struct adiv5_dap *dap)
 {
 	assert(dap->ops != NULL);
-	return dap->ops->run(dap);
+	int retval = dap->ops->run(dap);
+
+	/* queued SELECT, CSW or TAR writes may not have been performed */
+	if (retval != ERROR_OK)
+		dap_invalidate_cache(dap);
+	return retval;
 }
 
 static inline int dap_dp_read_atomic(struct adiv5_dap *dap, unsigned reg,
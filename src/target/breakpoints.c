@@ -43,33 +43,92 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+/* Breakpoints and watchpoints are kept in their target's list, in the
+ * order they were added, and indexed by address in a hash table so that
+ * lookups don't need to walk the list. Entries of a bucket keep the list
+ * order. */
+static inline unsigned bpwp_hash(uint32_t address)
+{
+	/* instructions are at least 2 byte aligned */
+	return ((address >> 1) * 2654435761u) >> (32 - BREAKPOINT_HASH_BITS);
+}
+
+static void breakpoint_hash_add(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint **bucket = &target->breakpoint_hash[bpwp_hash(breakpoint->address)];
+
+	while (*bucket)
+		bucket = &(*bucket)->hash_next;
+	breakpoint->hash_next = NULL;
+	*bucket = breakpoint;
+}
+
+static void breakpoint_hash_remove(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint **bucket = &target->breakpoint_hash[bpwp_hash(breakpoint->address)];
+
+	while (*bucket && *bucket != breakpoint)
+		bucket = &(*bucket)->hash_next;
+	if (*bucket)
+		*bucket = breakpoint->hash_next;
+}
+
+static void watchpoint_hash_add(struct target *target, struct watchpoint *watchpoint)
+{
+	struct watchpoint **bucket = &target->watchpoint_hash[bpwp_hash(watchpoint->address)];
+
+	while (*bucket)
+		bucket = &(*bucket)->hash_next;
+	watchpoint->hash_next = NULL;
+	*bucket = watchpoint;
+}
+
+static void watchpoint_hash_remove(struct target *target, struct watchpoint *watchpoint)
+{
+	struct watchpoint **bucket = &target->watchpoint_hash[bpwp_hash(watchpoint->address)];
+
+	while (*bucket && *bucket != watchpoint)
+		bucket = &(*bucket)->hash_next;
+	if (*bucket)
+		*bucket = watchpoint->hash_next;
+}
+
+static struct watchpoint *watchpoint_find(struct target *target, uint32_t address)
+{
+	struct watchpoint *watchpoint = target->watchpoint_hash[bpwp_hash(address)];
+
+	while (watchpoint) {
+		if (watchpoint->address == address)
+			return watchpoint;
+		watchpoint = watchpoint->hash_next;
+	}
+
+	return NULL;
+}
+
 int breakpoint_add_internal(struct target *target,
 	uint32_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 	struct breakpoint **breakpoint_p = &target->breakpoints;
 	const char *reason;
 	int retval;
-	int n;
 
-	n = 0;
-	while (breakpoint) {
-		n++;
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_DEBUG("Duplicate Breakpoint address: 0x%08" PRIx32 " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_OK;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_DEBUG("Duplicate Breakpoint address: 0x%08" PRIx32 " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_OK;
 	}
 
+	while (*breakpoint_p)
+		breakpoint_p = &(*breakpoint_p)->next;
+
 	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
 	(*breakpoint_p)->address = address;
 	(*breakpoint_p)->asid = 0;
@@ -100,6 +159,8 @@ fail:
 			return retval;
 	}
 
+	breakpoint_hash_add(target, *breakpoint_p);
+
 	LOG_DEBUG("added %s breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
 		(*breakpoint_p)->address, (*breakpoint_p)->length,
@@ -152,6 +213,8 @@ int context_breakpoint_add_internal(struct target *target,
 		return retval;
 	}
 
+	breakpoint_hash_add(target, *breakpoint_p);
+
 	LOG_DEBUG("added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
 		(*breakpoint_p)->asid, (*breakpoint_p)->length,
@@ -166,14 +229,16 @@ int hybrid_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = target->breakpoint_hash[bpwp_hash(address)];
 	struct breakpoint **breakpoint_p = &target->breakpoints;
 	int retval;
-	int n;
-	n = 0;
+
 	while (breakpoint) {
-		n++;
-		if ((breakpoint->asid == asid) && (breakpoint->address == address)) {
+		if (breakpoint->address != address) {
+			breakpoint = breakpoint->hash_next;
+			continue;
+		}
+		if (breakpoint->asid == asid) {
 			/* FIXME don't assume "same address" means "same
 			 * breakpoint" ... check all the parameters before
 			 * succeeding.
@@ -181,15 +246,16 @@ int hybrid_breakpoint_add_internal(struct target *target,
 			LOG_DEBUG("Duplicate Hybrid Breakpoint asid: 0x%08" PRIx32 " (BP %" PRIu32 ")",
 				asid, breakpoint->unique_id);
 			return -1;
-		} else if ((breakpoint->address == address) && (breakpoint->asid == 0)) {
+		} else if (breakpoint->asid == 0) {
 			LOG_DEBUG("Duplicate Breakpoint IVA: 0x%08" PRIx32 " (BP %" PRIu32 ")",
 				address, breakpoint->unique_id);
 			return -1;
 
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+		breakpoint = breakpoint->hash_next;
 	}
+	while (*breakpoint_p)
+		breakpoint_p = &(*breakpoint_p)->next;
 	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
 	(*breakpoint_p)->address = address;
 	(*breakpoint_p)->asid = asid;
@@ -209,6 +275,7 @@ int hybrid_breakpoint_add_internal(struct target *target,
 		*breakpoint_p = NULL;
 		return retval;
 	}
+	breakpoint_hash_add(target, *breakpoint_p);
 	LOG_DEBUG(
 		"added %s Hybrid breakpoint at address 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
@@ -307,6 +374,7 @@ static void breakpoint_free(struct target *target, struct breakpoint *breakpoint
 	retval = target_remove_breakpoint(target, breakpoint);
 
 	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
+	breakpoint_hash_remove(target, breakpoint);
 	(*breakpoint_p) = breakpoint->next;
 	free(breakpoint->orig_instr);
 	free(breakpoint);
@@ -314,16 +382,16 @@ static void breakpoint_free(struct target *target, struct breakpoint *breakpoint
 
 int breakpoint_remove_internal(struct target *target, uint32_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-
-	while (breakpoint) {
-		if ((breakpoint->address == address) && (breakpoint->asid == 0))
-			break;
-		else if ((breakpoint->address == 0) && (breakpoint->asid == address))
-			break;
-		else if ((breakpoint->address == address) && (breakpoint->asid != 0))
-			break;
-		breakpoint = breakpoint->next;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
+
+	/* context breakpoints are removed by their asid */
+	if (breakpoint == NULL) {
+		breakpoint = target->breakpoint_hash[bpwp_hash(0)];
+		while (breakpoint) {
+			if ((breakpoint->address == 0) && (breakpoint->asid == address))
+				break;
+			breakpoint = breakpoint->hash_next;
+		}
 	}
 
 	if (breakpoint) {
@@ -379,12 +447,12 @@ void breakpoint_clear_target(struct target *target)
 
 struct breakpoint *breakpoint_find(struct target *target, uint32_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = target->breakpoint_hash[bpwp_hash(address)];
 
 	while (breakpoint) {
 		if (breakpoint->address == address)
 			return breakpoint;
-		breakpoint = breakpoint->next;
+		breakpoint = breakpoint->hash_next;
 	}
 
 	return NULL;
@@ -393,30 +461,29 @@ struct breakpoint *breakpoint_find(struct target *target, uint32_t address)
 int watchpoint_add(struct target *target, uint32_t address, uint32_t length,
 	enum watchpoint_rw rw, uint32_t value, uint32_t mask)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
+	struct watchpoint *watchpoint = watchpoint_find(target, address);
 	struct watchpoint **watchpoint_p = &target->watchpoints;
 	int retval;
 	const char *reason;
 
-	while (watchpoint) {
-		if (watchpoint->address == address) {
-			if (watchpoint->length != length
-				|| watchpoint->value != value
-				|| watchpoint->mask != mask
-				|| watchpoint->rw != rw) {
-				LOG_ERROR("address 0x%8.8" PRIx32
-					"already has watchpoint %d",
-					address, watchpoint->unique_id);
-				return ERROR_FAIL;
-			}
-
-			/* ignore duplicate watchpoint */
-			return ERROR_OK;
+	if (watchpoint) {
+		if (watchpoint->length != length
+			|| watchpoint->value != value
+			|| watchpoint->mask != mask
+			|| watchpoint->rw != rw) {
+			LOG_ERROR("address 0x%8.8" PRIx32
+				"already has watchpoint %d",
+				address, watchpoint->unique_id);
+			return ERROR_FAIL;
 		}
-		watchpoint_p = &watchpoint->next;
-		watchpoint = watchpoint->next;
+
+		/* ignore duplicate watchpoint */
+		return ERROR_OK;
 	}
 
+	while (*watchpoint_p)
+		watchpoint_p = &(*watchpoint_p)->next;
+
 	(*watchpoint_p) = calloc(1, sizeof(struct watchpoint));
 	(*watchpoint_p)->address = address;
 	(*watchpoint_p)->length = length;
@@ -446,6 +513,8 @@ bye:
 			return retval;
 	}
 
+	watchpoint_hash_add(target, *watchpoint_p);
+
 	LOG_DEBUG("added %s watchpoint at 0x%8.8" PRIx32
 		" of length 0x%8.8" PRIx32 " (WPID: %d)",
 		watchpoint_rw_strings[(*watchpoint_p)->rw],
@@ -473,19 +542,14 @@ static void watchpoint_free(struct target *target, struct watchpoint *watchpoint
 		return;
 	retval = target_remove_watchpoint(target, watchpoint);
 	LOG_DEBUG("free WPID: %d --> %d", watchpoint->unique_id, retval);
+	watchpoint_hash_remove(target, watchpoint);
 	(*watchpoint_p) = watchpoint->next;
 	free(watchpoint);
 }
 
 void watchpoint_remove(struct target *target, uint32_t address)
 {
-	struct watchpoint *watchpoint = target->watchpoints;
-
-	while (watchpoint) {
-		if (watchpoint->address == address)
-			break;
-		watchpoint = watchpoint->next;
-	}
+	struct watchpoint *watchpoint = watchpoint_find(target, address);
 
 	if (watchpoint)
 		watchpoint_free(target, watchpoint);
@@ -40,6 +40,7 @@ struct breakpoint {
 	int set;
 	uint8_t *orig_instr;
 	struct breakpoint *next;
+	struct breakpoint *hash_next;	/* next in the same target->breakpoint_hash bucket */
 	uint32_t unique_id;
 	int linked_BRP;
 };
@@ -52,6 +53,7 @@ struct watchpoint {
 	enum watchpoint_rw rw;
 	int set;
 	struct watchpoint *next;
+	struct watchpoint *hash_next;	/* next in the same target->watchpoint_hash bucket */
 	int unique_id;
 };
 
@@ -3010,6 +3010,15 @@ static int cortex_a_init_target(struct command_context *cmd_ctx,
 	return ERROR_OK;
 }
 
+static void cortex_a_deinit_target(struct target *target)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+
+	/* the DAP of a TAP belongs to the first target created on it */
+	if (armv7a->arm.dap == &armv7a->dap)
+		dap_deinit(&armv7a->dap);
+}
+
 static int cortex_a_init_arch_info(struct target *target,
 	struct cortex_a_common *cortex_a, struct jtag_tap *tap)
 {
@@ -3283,6 +3292,7 @@ struct target_type cortexa_target = {
 	.commands = cortex_a_command_handlers,
 	.target_create = cortex_a_target_create,
 	.init_target = cortex_a_init_target,
+	.deinit_target = cortex_a_deinit_target,
 	.examine = cortex_a_examine,
 
 	.read_phys_memory = cortex_a_read_phys_memory,
@@ -3360,5 +3370,6 @@ struct target_type cortexr4_target = {
 	.commands = cortex_r4_command_handlers,
 	.target_create = cortex_r4_target_create,
 	.init_target = cortex_a_init_target,
+	.deinit_target = cortex_a_deinit_target,
 	.examine = cortex_a_examine,
 };
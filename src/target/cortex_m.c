@@ -674,16 +674,119 @@ static int cortex_m_soft_reset_halt(struct target *target)
 	return ERROR_OK;
 }
 
-void cortex_m_enable_breakpoints(struct target *target)
+/* Write all pending two byte software breakpoints with one queue to read
+ * the original instructions and one to write the BKPT instructions. Those
+ * that can't be handled here are left to cortex_m_set_breakpoint(). */
+static int cortex_m_set_soft_breakpoints(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = &cortex_m->armv7m;
+	struct adiv5_dap *swjdp = armv7m->arm.dap;
+	struct breakpoint *breakpoint;
+	int retval;
+	int count = 0;
+
+	/* high level adapters have no DAP queue */
+	if (armv7m->stlink || swjdp->ti_be_32_quirks)
+		return ERROR_OK;
+
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (cortex_m->auto_bp_type)
+			breakpoint->type = BKPT_TYPE_BY_ADDR(breakpoint->address);
+		if (!breakpoint->set && breakpoint->type == BKPT_SOFT && breakpoint->length == 2)
+			count++;
+	}
+
+	if (count < 2)
+		return ERROR_OK;
+
+	uint32_t *words = malloc(count * sizeof(*words));
+	if (words == NULL)
+		return ERROR_FAIL;
+
+	/* queue the reads of the words holding the original instructions */
+	int i = 0;
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (breakpoint->set || breakpoint->type != BKPT_SOFT || breakpoint->length != 2)
+			continue;
+		retval = mem_ap_read_u32(swjdp, breakpoint->address & ~3, &words[i++]);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+	retval = dap_run(swjdp);
+	if (retval != ERROR_OK)
+		goto done;
+
+	/* keep the original halfwords and queue the halfword writes of BKPT */
+	i = 0;
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (breakpoint->set || breakpoint->type != BKPT_SOFT || breakpoint->length != 2)
+			continue;
+		unsigned shift = 8 * (breakpoint->address & 2);
+		breakpoint->orig_instr[0] = words[i] >> shift;
+		breakpoint->orig_instr[1] = words[i] >> (shift + 8);
+		i++;
+
+		/* NOTE: BKPT(0xab) is used for semihosting, see cortex_m_set_breakpoint() */
+		retval = dap_setup_accessport(swjdp, CSW_16BIT | CSW_ADDRINC_OFF,
+				breakpoint->address & ~1);
+		if (retval != ERROR_OK)
+			goto done;
+		retval = dap_queue_ap_write(swjdp, AP_REG_DRW,
+				(ARMV5_T_BKPT(0x11) & 0xffff) << shift);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+	retval = dap_run(swjdp);
+	if (retval != ERROR_OK) {
+		/* Some BKPTs may have been written; put the original
+		 * instructions back so they can be set one by one */
+		for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+			if (breakpoint->set || breakpoint->type != BKPT_SOFT || breakpoint->length != 2)
+				continue;
+			target_write_memory(target, breakpoint->address & ~1, 2, 1,
+					breakpoint->orig_instr);
+		}
+		goto done;
+	}
+
+	/* from now on, unsetting them restores the right instruction */
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (breakpoint->type == BKPT_SOFT && breakpoint->length == 2)
+			breakpoint->set = true;
+	}
+
+	LOG_DEBUG("set %d software breakpoints", count);
+
+done:
+	free(words);
+	return retval;
+}
+
+/* Set any pending breakpoints. Software breakpoints added while halted are
+ * only written here, so a failure must keep the core from running. */
+int cortex_m_enable_breakpoints(struct target *target)
 {
 	struct breakpoint *breakpoint = target->breakpoints;
+	int retval = ERROR_OK;
+
+	/* software ones in one batch if possible */
+	if (cortex_m_set_soft_breakpoints(target) != ERROR_OK)
+		LOG_ERROR("setting software breakpoints in one batch failed, retrying one by one");
 
-	/* set any pending breakpoints */
 	while (breakpoint) {
-		if (!breakpoint->set)
-			cortex_m_set_breakpoint(target, breakpoint);
+		if (!breakpoint->set) {
+			int retval2 = cortex_m_set_breakpoint(target, breakpoint);
+			if (retval2 != ERROR_OK) {
+				LOG_ERROR("can't set breakpoint at 0x%08" PRIx32, breakpoint->address);
+				if (retval == ERROR_OK)
+					retval = retval2;
+			}
+		}
 		breakpoint = breakpoint->next;
 	}
+
+	return retval;
 }
 
 static int cortex_m_resume(struct target *target, int current,
@@ -693,6 +796,7 @@ static int cortex_m_resume(struct target *target, int current,
 	struct breakpoint *breakpoint = NULL;
 	uint32_t resume_pc;
 	struct reg *r;
+	int retval;
 
 	if (target->state != TARGET_HALTED) {
 		LOG_WARNING("target not halted");
@@ -701,7 +805,9 @@ static int cortex_m_resume(struct target *target, int current,
 
 	if (!debug_execution) {
 		target_free_all_working_areas(target);
-		cortex_m_enable_breakpoints(target);
+		retval = cortex_m_enable_breakpoints(target);
+		if (retval != ERROR_OK)
+			return retval;
 		cortex_m_enable_watchpoints(target);
 	}
 
@@ -748,7 +854,9 @@ static int cortex_m_resume(struct target *target, int current,
 
 	resume_pc = buf_get_u32(r->value, 0, 32);
 
-	armv7m_restore_context(target);
+	retval = armv7m_restore_context(target);
+	if (retval != ERROR_OK)
+		return retval;
 
 	/* the front-end may request us not to handle breakpoints */
 	if (handle_breakpoints) {
@@ -809,6 +917,13 @@ static int cortex_m_step(struct target *target, int current,
 
 	uint32_t pc_value = buf_get_u32(pc->value, 0, 32);
 
+	/* Breakpoints added while halted are still pending. Stepping may run
+	 * the core for a while, to serve interrupts, or leave it running on
+	 * a timeout, so write them now. */
+	retval = cortex_m_enable_breakpoints(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* the front-end may request us not to handle breakpoints */
 	if (handle_breakpoints) {
 		breakpoint = breakpoint_find(target, pc_value);
@@ -820,7 +935,9 @@ static int cortex_m_step(struct target *target, int current,
 
 	target->debug_reason = DBG_REASON_SINGLESTEP;
 
-	armv7m_restore_context(target);
+	retval = armv7m_restore_context(target);
+	if (retval != ERROR_OK)
+		return retval;
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUMED);
 
@@ -878,8 +995,13 @@ static int cortex_m_step(struct target *target, int current,
 				/* Set a temporary break point */
 				if (breakpoint)
 					retval = cortex_m_set_breakpoint(target, breakpoint);
-				else
+				else {
 					retval = breakpoint_add(target, pc_value, 2, BKPT_TYPE_BY_ADDR(pc_value));
+					/* software breakpoints are only written on resume, do it now */
+					struct breakpoint *tmp_bp = breakpoint_find(target, pc_value);
+					if (retval == ERROR_OK && tmp_bp && !tmp_bp->set)
+						retval = cortex_m_set_breakpoint(target, tmp_bp);
+				}
 				bool tmp_bp_set = (retval == ERROR_OK);
 
 				/* No more breakpoints left, just do a step */
@@ -1280,6 +1402,12 @@ int cortex_m_add_breakpoint(struct target *target, struct breakpoint *breakpoint
 	if (breakpoint->type == BKPT_HARD)
 		cortex_m->fp_code_available--;
 
+	/* software breakpoints of a halted core are written together on resume,
+	 * which fails if one of them can't be written */
+	if (breakpoint->type == BKPT_SOFT && target->state == TARGET_HALTED
+			&& !cortex_m->armv7m.stlink)
+		return ERROR_OK;
+
 	return cortex_m_set_breakpoint(target, breakpoint);
 }
 
@@ -1652,6 +1780,153 @@ static int cortex_m_store_core_reg_u32(struct target *target,
 	return ERROR_OK;
 }
 
+static int cortex_m_queue_core_reg_write(struct adiv5_dap *swjdp,
+		uint32_t selector, uint32_t value)
+{
+	int retval = mem_ap_write_u32(swjdp, DCB_DCRDR, value);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return mem_ap_write_u32(swjdp, DCB_DCRSR, selector | DCRSR_WnR);
+}
+
+static bool cortex_m_core_reg_flushable(int num)
+{
+	return (num >= 0 && num <= 18)
+		|| (num >= ARMV7M_PRIMASK && num <= ARMV7M_CONTROL)
+		|| (num >= ARMV7M_S0 && num <= ARMV7M_S31)
+		|| (num >= ARMV7M_D0 && num <= ARMV7M_D15)
+		|| num == ARMV7M_FPSCR;
+}
+
+/* Write all dirty core registers with one DAP queue, in the order
+ * armv7m_restore_context() would write them one by one. */
+static int cortex_m_flush_core_regs(struct reg_cache *cache)
+{
+	struct arm_reg *arm_reg = cache->reg_list[0].arch_info;
+	struct target *target = arm_reg->target;
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_dap *swjdp = armv7m->arm.dap;
+	bool special_dirty = false;
+	bool special_cached = true;
+	uint32_t special = 0;
+	uint32_t dcrdr;
+	int retval = ERROR_OK;
+
+	/* PRIMASK, BASEPRI, FAULTMASK and CONTROL share one Debug Core
+	 * register; start from its current value unless all are cached */
+	for (unsigned i = 0; i < cache->num_regs; i++) {
+		int num = ((struct arm_reg *)cache->reg_list[i].arch_info)->num;
+		if (num >= ARMV7M_PRIMASK && num <= ARMV7M_CONTROL) {
+			special_dirty |= cache->reg_list[i].dirty;
+			special_cached &= cache->reg_list[i].valid;
+		}
+	}
+	if (special_dirty) {
+		if (!special_cached) {
+			retval = cortexm_dap_read_coreregister_u32(target, &special, 20);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		for (unsigned i = 0; i < cache->num_regs; i++) {
+			struct reg *r = &cache->reg_list[i];
+			uint32_t value = buf_get_u32(r->value, 0, 32);
+			if (!r->valid)
+				continue;
+			switch (((struct arm_reg *)r->arch_info)->num) {
+				case ARMV7M_PRIMASK:
+					buf_set_u32((uint8_t *)&special, 0, 1, value);
+					break;
+				case ARMV7M_BASEPRI:
+					buf_set_u32((uint8_t *)&special, 8, 8, value);
+					break;
+				case ARMV7M_FAULTMASK:
+					buf_set_u32((uint8_t *)&special, 16, 1, value);
+					break;
+				case ARMV7M_CONTROL:
+					buf_set_u32((uint8_t *)&special, 24, 2, value);
+					break;
+			}
+		}
+	}
+
+	/* DCRDR doubles as the emulated DCC channel, see
+	 * cortexm_dap_write_coreregister_u32() */
+	if (target->dbg_msg_enabled) {
+		retval = mem_ap_read_atomic_u32(swjdp, DCB_DCRDR, &dcrdr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (int i = cache->num_regs - 1; i >= 0 && retval == ERROR_OK; i--) {
+		struct reg *r = &cache->reg_list[i];
+		int num = ((struct arm_reg *)r->arch_info)->num;
+		uint32_t value = buf_get_u32(r->value, 0, 32);
+
+		if (!r->dirty)
+			continue;
+
+		switch (num) {
+			case 0 ... 18:
+				retval = cortex_m_queue_core_reg_write(swjdp, num, value);
+				break;
+
+			case ARMV7M_PRIMASK ... ARMV7M_CONTROL:
+				if (special_dirty) {
+					retval = cortex_m_queue_core_reg_write(swjdp, 20, special);
+					special_dirty = false;
+				}
+				break;
+
+			case ARMV7M_S0 ... ARMV7M_S31:
+				retval = cortex_m_queue_core_reg_write(swjdp, num - ARMV7M_S0 + 0x40, value);
+				break;
+
+			case ARMV7M_D0 ... ARMV7M_D15:
+				retval = cortex_m_queue_core_reg_write(swjdp,
+						2 * (num - ARMV7M_D0) + 0x40, value);
+				if (retval == ERROR_OK)
+					retval = cortex_m_queue_core_reg_write(swjdp,
+							2 * (num - ARMV7M_D0) + 0x41,
+							buf_get_u32((uint8_t *)r->value + 4, 0, 32));
+				break;
+
+			case ARMV7M_FPSCR:
+				retval = cortex_m_queue_core_reg_write(swjdp, 0x21, value);
+				break;
+
+			default:
+				LOG_ERROR("can't write register %s", r->name);
+				break;
+		}
+	}
+
+	if (retval == ERROR_OK)
+		retval = dap_run(swjdp);
+
+	if (target->dbg_msg_enabled) {
+		/* restore DCB_DCRDR in a separate transaction */
+		int retval2 = mem_ap_write_atomic_u32(swjdp, DCB_DCRDR, dcrdr);
+		if (retval == ERROR_OK)
+			retval = retval2;
+	}
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("JTAG failure");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	for (unsigned i = 0; i < cache->num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
+		if (r->dirty && cortex_m_core_reg_flushable(((struct arm_reg *)r->arch_info)->num)) {
+			r->valid = 1;
+			r->dirty = 0;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int cortex_m_read_memory(struct target *target, uint32_t address,
 	uint32_t size, uint32_t count, uint8_t *buffer)
 {
@@ -1685,7 +1960,11 @@ static int cortex_m_write_memory(struct target *target, uint32_t address,
 static int cortex_m_init_target(struct command_context *cmd_ctx,
 	struct target *target)
 {
-	armv7m_build_reg_cache(target);
+	struct reg_cache *cache = armv7m_build_reg_cache(target);
+
+	/* restore the whole context with one DAP queue */
+	if (cache)
+		cache->flush = cortex_m_flush_core_regs;
 	return ERROR_OK;
 }
 
@@ -1697,6 +1976,7 @@ void cortex_m_deinit_target(struct target *target)
 
 	cortex_m_dwt_free(target);
 	armv7m_free_reg_cache(target);
+	dap_deinit(&cortex_m->armv7m.dap);
 
 	free(cortex_m);
 }
@@ -1816,6 +2096,7 @@ fail1:
 	cache->num_regs = 2 + cm->dwt_num_comp * 3;
 	cache->reg_list = calloc(cache->num_regs, sizeof *cache->reg_list);
 	if (!cache->reg_list) {
+		register_cache_free_index(cache);
 		free(cache);
 		goto fail1;
 	}
@@ -1866,6 +2147,7 @@ static void cortex_m_dwt_free(struct target *target)
 				free(cache->reg_list[i].arch_info);
 			free(cache->reg_list);
 		}
+		register_cache_free_index(cache);
 		free(cache);
 	}
 	cm->dwt_cache = NULL;
@@ -2124,6 +2406,92 @@ static int cortex_m_init_arch_info(struct target *target,
 	return ERROR_OK;
 }
 
+/* PC samples read from DWT_PCSR per transaction */
+#define CORTEX_M_PCSR_BATCH	256
+
+/* Sample the PC through DWT_PCSR while the core keeps running. Each
+ * batch is one non-incrementing block read of the register, so the rate
+ * is limited only by the adapter. */
+static int cortex_m_profiling(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_dap *swjdp = armv7m->arm.dap;
+	struct timeval timeout, now;
+	uint32_t reg_value;
+	int retval;
+
+	/* PCSR reads as zero when it isn't implemented, e.g. on most ARMv6-M */
+	retval = mem_ap_read_atomic_u32(swjdp, DWT_PCSR, &reg_value);
+	if (retval != ERROR_OK)
+		return retval;
+	if (reg_value == 0) {
+		LOG_INFO("DWT_PCSR not implemented");
+		return target_profiling_default(target, samples, max_num_samples,
+				num_samples, seconds);
+	}
+
+	target_poll(target);
+	bool was_halted = target->state == TARGET_HALTED;
+	if (was_halted) {
+		/* current pc, addr = 0, do not handle breakpoints, not debugging */
+		retval = target_resume(target, 1, 0, 0, 0);
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (target->state != TARGET_RUNNING) {
+		LOG_INFO("Target not halted or running");
+		*num_samples = 0;
+		return ERROR_OK;
+	}
+
+	gettimeofday(&timeout, NULL);
+	timeval_add_time(&timeout, seconds, 0);
+
+	LOG_INFO("Starting profiling. Sampling DWT_PCSR as fast as we can...");
+
+	uint8_t buf[CORTEX_M_PCSR_BATCH * 4];
+	uint32_t sample_count = 0;
+	while (sample_count < max_num_samples) {
+		uint32_t count = max_num_samples - sample_count;
+		if (count > CORTEX_M_PCSR_BATCH)
+			count = CORTEX_M_PCSR_BATCH;
+
+		retval = mem_ap_read(swjdp, buf, 4, count, DWT_PCSR, false);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Error while reading PCSR");
+			break;
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t pc = target_buffer_get_u32(target, buf + 4 * i);
+			/* all ones while the core is halted */
+			if (pc != 0xffffffff)
+				samples[sample_count++] = pc;
+		}
+
+		keep_alive();
+
+		gettimeofday(&now, NULL);
+		if (now.tv_sec > timeout.tv_sec ||
+				(now.tv_sec == timeout.tv_sec && now.tv_usec >= timeout.tv_usec))
+			break;
+	}
+
+	LOG_INFO("Profiling completed. %" PRIu32 " samples.", sample_count);
+
+	/* leave the target halted if it was before */
+	if (was_halted) {
+		int halt_retval = target_halt(target);
+		if (halt_retval == ERROR_OK)
+			halt_retval = target_wait_state(target, TARGET_HALTED, 500);
+		if (retval == ERROR_OK)
+			retval = halt_retval;
+	}
+
+	*num_samples = sample_count;
+	return retval;
+}
+
 static int cortex_m_target_create(struct target *target, Jim_Interp *interp)
 {
 	struct cortex_m_common *cortex_m = calloc(1, sizeof(struct cortex_m_common));
@@ -2396,4 +2764,6 @@ struct target_type cortexm_target = {
 	.init_target = cortex_m_init_target,
 	.examine = cortex_m_examine,
 	.deinit_target = cortex_m_deinit_target,
+
+	.profiling = cortex_m_profiling,
 };
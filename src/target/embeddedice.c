@@ -175,7 +175,7 @@ struct reg_cache *embeddedice_build_reg_cache(struct target *target,
 		struct arm7_9_common *arm7_9)
 {
 	int retval;
-	struct reg_cache *reg_cache = malloc(sizeof(struct reg_cache));
+	struct reg_cache *reg_cache = calloc(1, sizeof(struct reg_cache));
 	struct reg *reg_list = NULL;
 	struct embeddedice_reg *arch_info = NULL;
 	struct arm_jtag *jtag_info = &arm7_9->jtag_info;
@@ -222,6 +222,7 @@ struct reg_cache *embeddedice_build_reg_cache(struct target *target,
 		for (i = 0; i < num_regs; i++)
 			free(reg_list[i].value);
 		free(reg_list);
+		register_cache_free_index(reg_cache);
 		free(reg_cache);
 		free(arch_info);
 		return NULL;
@@ -631,6 +632,9 @@ int embeddedice_handshake(struct arm_jtag *jtag_info, int hsbit, uint32_t timeou
 }
 
 #ifndef HAVE_JTAG_MINIDRIVER_H
+/* Words of an open loop DCC write queued between asynchronous flushes */
+#define EICE_DCC_FLUSH_WORDS 1024
+
 /**
  * This is an inner loop of the open loop DCC write of data to target
  */
@@ -638,11 +642,18 @@ void embeddedice_write_dcc(struct jtag_tap *tap,
 		int reg_addr, const uint8_t *buffer, int little, int count)
 {
 	int i;
+	bool async = jtag_get_io_worker();
 
 	for (i = 0; i < count; i++) {
 		embeddedice_write_reg_inner(tap, reg_addr,
 				fast_target_buffer_get_u32(buffer, little));
 		buffer += 4;
+
+		/* Nothing is read back, so let the I/O worker shift out this
+		 * part while the next one is queued. Errors are reported by
+		 * the caller's next jtag_execute_queue(). */
+		if (async && (i + 1) % EICE_DCC_FLUSH_WORDS == 0 && i + 1 < count)
+			jtag_execute_queue_async();
 	}
 }
 #else
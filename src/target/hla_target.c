@@ -606,7 +606,9 @@ static int adapter_resume(struct target *target, int current,
 
 	if (!debug_execution) {
 		target_free_all_working_areas(target);
-		cortex_m_enable_breakpoints(target);
+		res = cortex_m_enable_breakpoints(target);
+		if (res != ERROR_OK)
+			return res;
 		cortex_m_enable_watchpoints(target);
 	}
 
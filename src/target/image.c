@@ -486,6 +486,12 @@ static int image_elf_read_section(struct image *image,
 		LOG_DEBUG("read elf: size = 0x%zu at 0x%" PRIx32 "", read_size,
 			field32(elf, segment->p_offset) + offset);
 		/* read initialized area of the segment */
+		const uint8_t *data = image_section_data(image, section, offset, read_size);
+		if (data) {
+			memcpy(buffer, data, read_size);
+			*size_read += read_size;
+			return ERROR_OK;
+		}
 		retval = fileio_seek(&elf->fileio, field32(elf, segment->p_offset) + offset);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("cannot find ELF segment content, seek failed");
@@ -714,6 +720,9 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			return retval;
 		}
 
+		if (fileio_map(&image_binary->fileio, &image_binary->data) != ERROR_OK)
+			image_binary->data = NULL;
+
 		image->num_sections = 1;
 		image->sections = malloc(sizeof(struct imagesection));
 		image->sections[0].base_address = 0x0;
@@ -749,6 +758,14 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			fileio_close(&image_elf->fileio);
 			return retval;
 		}
+
+		/* serve segment contents straight from the file when possible */
+		int filesize;
+		if (fileio_size(&image_elf->fileio, &filesize) != ERROR_OK ||
+				fileio_map(&image_elf->fileio, &image_elf->data) != ERROR_OK)
+			image_elf->data = NULL;
+		else
+			image_elf->data_size = filesize;
 	} else if (image->type == IMAGE_MEMORY) {
 		struct target *target = get_target(url);
 
@@ -834,6 +851,12 @@ int image_read_section(struct image *image,
 		if (section != 0)
 			return ERROR_COMMAND_SYNTAX_ERROR;
 
+		if (image_binary->data) {
+			memcpy(buffer, image_binary->data + offset, size);
+			*size_read = size;
+			return ERROR_OK;
+		}
+
 		/* seek to offset */
 		retval = fileio_seek(&image_binary->fileio, offset);
 		if (retval != ERROR_OK)
@@ -903,6 +926,52 @@ int image_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+/**
+ * Get the contents of an image section in place, without copying them.
+ *
+ * This works for images which keep their contents in memory (IHEX, S19,
+ * builder) or whose file could be mapped (binary, ELF). Otherwise, and for
+ * the parts of an ELF segment which are not backed by the file, NULL is
+ * returned and the caller has to use image_read_section() instead.
+ *
+ * The data stays valid until image_close().
+ */
+const uint8_t *image_section_data(struct image *image, int section,
+		uint32_t offset, uint32_t size)
+{
+	if (section < 0 || section >= image->num_sections ||
+			offset + size < offset || offset + size > image->sections[section].size)
+		return NULL;
+
+	if (image->type == IMAGE_BINARY) {
+		struct image_binary *image_binary = image->type_private;
+
+		if (!image_binary->data)
+			return NULL;
+
+		return image_binary->data + offset;
+	} else if (image->type == IMAGE_ELF) {
+		struct image_elf *elf = image->type_private;
+		Elf32_Phdr *segment = (Elf32_Phdr *)image->sections[section].private;
+		uint32_t file_offset = field32(elf, segment->p_offset);
+
+		if (!elf->data)
+			return NULL;
+
+		/* truncated files are left to fileio_read() to report */
+		if (file_offset > elf->data_size ||
+				offset + size > elf->data_size - file_offset)
+			return NULL;
+
+		return elf->data + file_offset + offset;
+	} else if (image->type == IMAGE_IHEX || image->type == IMAGE_SRECORD ||
+			image->type == IMAGE_BUILDER) {
+		return (uint8_t *)image->sections[section].private + offset;
+	}
+
+	return NULL;
+}
+
 int image_add_section(struct image *image, uint32_t base, uint32_t size, int flags, uint8_t const *data)
 {
 	struct imagesection *section;
@@ -1005,37 +1074,74 @@ void image_close(struct image *image)
 	}
 }
 
-int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
-{
-	uint32_t crc = 0xffffffff;
-	LOG_DEBUG("Calculating checksum");
-
-	static uint32_t crc32_table[256];
+/* CRC32 as used by gdb and the target side checksum algorithms: polynomial
+ * 0x04c11db7, MSB first, no final inversion. crc32_table[0] is the classic
+ * byte table, crc32_table[k] advances a byte through k further zero bytes,
+ * so eight bytes can be folded in with eight independent lookups. */
+static uint32_t crc32_table[8][256];
 
+static void image_crc32_init_tables(void)
+{
 	static bool first_init;
-	if (!first_init) {
-		/* Initialize the CRC table and the decoding table.  */
-		int i, j;
-		unsigned int c;
-		for (i = 0; i < 256; i++) {
-			/* as per gdb */
-			for (c = i << 24, j = 8; j > 0; --j)
-				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
-			crc32_table[i] = c;
+	if (first_init)
+		return;
+
+	for (unsigned int i = 0; i < 256; i++) {
+		/* as per gdb */
+		uint32_t c = i << 24;
+		for (int j = 8; j > 0; --j)
+			c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
+		crc32_table[0][i] = c;
+	}
+
+	for (unsigned int i = 0; i < 256; i++) {
+		uint32_t c = crc32_table[0][i];
+		for (int k = 1; k < 8; k++) {
+			c = (c << 8) ^ crc32_table[0][c >> 24];
+			crc32_table[k][i] = c;
 		}
+	}
+
+	first_init = true;
+}
 
-		first_init = true;
+uint32_t image_crc32_update(uint32_t crc, const uint8_t *buffer, size_t nbytes)
+{
+	image_crc32_init_tables();
+
+	while (nbytes >= 8) {
+		crc ^= (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 |
+			(uint32_t)buffer[2] << 8 | buffer[3];
+		crc = crc32_table[7][crc >> 24] ^
+			crc32_table[6][(crc >> 16) & 255] ^
+			crc32_table[5][(crc >> 8) & 255] ^
+			crc32_table[4][crc & 255] ^
+			crc32_table[3][buffer[4]] ^
+			crc32_table[2][buffer[5]] ^
+			crc32_table[1][buffer[6]] ^
+			crc32_table[0][buffer[7]];
+		buffer += 8;
+		nbytes -= 8;
 	}
 
+	while (nbytes--)
+		crc = (crc << 8) ^ crc32_table[0][((crc >> 24) ^ *buffer++) & 255];
+
+	return crc;
+}
+
+int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
+{
+	uint32_t crc = IMAGE_CRC32_INIT;
+	LOG_DEBUG("Calculating checksum");
+
 	while (nbytes > 0) {
-		int run = nbytes;
-		if (run > 32768)
-			run = 32768;
+		uint32_t run = nbytes;
+		if (run > 1024 * 1024)
+			run = 1024 * 1024;
+		crc = image_crc32_update(crc, buffer, run);
+		buffer += run;
 		nbytes -= run;
-		while (run--) {
-			/* as per gdb */
-			crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *buffer++) & 255];
-		}
 		keep_alive();
 	}
 
@@ -67,6 +67,7 @@ struct image {
 
 struct image_binary {
 	struct fileio fileio;
+	const uint8_t *data;	/* file mapping, if available */
 };
 
 struct image_ihex {
@@ -86,6 +87,8 @@ struct image_elf {
 	Elf32_Phdr *segments;
 	uint32_t segment_count;
 	uint8_t endianness;
+	const uint8_t *data;	/* file mapping, if available */
+	uint32_t data_size;
 };
 
 struct image_mot {
@@ -103,6 +106,13 @@ int image_add_section(struct image *image, uint32_t base, uint32_t size,
 
 int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
+const uint8_t *image_section_data(struct image *image, int section,
+		uint32_t offset, uint32_t size);
+
+/* Incremental CRC32, same algorithm as image_calculate_checksum(). Start
+ * with IMAGE_CRC32_INIT and feed the data in any number of pieces. */
+#define IMAGE_CRC32_INIT	0xffffffff
+uint32_t image_crc32_update(uint32_t crc, const uint8_t *buffer, size_t nbytes);
 
 #define ERROR_IMAGE_FORMAT_ERROR	(-1400)
 #define ERROR_IMAGE_TYPE_UNKNOWN	(-1401)
@@ -403,6 +403,7 @@ static struct reg_cache *nds32_build_reg_cache(struct target *target,
 	int i;
 
 	if (!cache || !reg_list || !reg_arch_info) {
+		register_cache_free_index(cache);
 		free(cache);
 		free(reg_list);
 		free(reg_arch_info);
@@ -38,17 +38,88 @@
  * may be separate registers associated with debug or trace modules.
  */
 
+static unsigned register_name_hash(const char *name)
+{
+	/* FNV-1a */
+	unsigned hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Index the registers of a cache by name, in an open addressing table at
+ * most half full. The first register of a given name wins, as it did for
+ * the linear search. */
+static int register_cache_build_index(struct reg_cache *cache)
+{
+	unsigned size = 8;
+
+	while (size < 2 * cache->num_regs)
+		size *= 2;
+
+	struct reg **index = calloc(size, sizeof(*index));
+	if (index == NULL)
+		return ERROR_FAIL;
+
+	for (unsigned i = 0; i < cache->num_regs; i++) {
+		struct reg *reg = &cache->reg_list[i];
+		unsigned slot = register_name_hash(reg->name) & (size - 1);
+
+		while (index[slot] && strcmp(index[slot]->name, reg->name) != 0)
+			slot = (slot + 1) & (size - 1);
+		if (index[slot] == NULL)
+			index[slot] = reg;
+	}
+
+	free(cache->name_index);
+	cache->name_index = index;
+	cache->name_index_size = size;
+	cache->name_index_regs = cache->num_regs;
+	cache->name_index_list = cache->reg_list;
+
+	return ERROR_OK;
+}
+
+static struct reg *register_cache_find(struct reg_cache *cache, const char *name)
+{
+	/* (re)build the index if the cache was set up or changed since */
+	if (cache->name_index == NULL
+			|| cache->name_index_regs != cache->num_regs
+			|| cache->name_index_list != cache->reg_list) {
+		if (register_cache_build_index(cache) != ERROR_OK) {
+			for (unsigned i = 0; i < cache->num_regs; i++) {
+				if (strcmp(cache->reg_list[i].name, name) == 0)
+					return &(cache->reg_list[i]);
+			}
+			return NULL;
+		}
+	}
+
+	unsigned mask = cache->name_index_size - 1;
+	unsigned slot = register_name_hash(name) & mask;
+
+	while (cache->name_index[slot]) {
+		if (strcmp(cache->name_index[slot]->name, name) == 0)
+			return cache->name_index[slot];
+		slot = (slot + 1) & mask;
+	}
+
+	return NULL;
+}
+
 struct reg *register_get_by_name(struct reg_cache *first,
 		const char *name, bool search_all)
 {
-	unsigned i;
 	struct reg_cache *cache = first;
 
 	while (cache) {
-		for (i = 0; i < cache->num_regs; i++) {
-			if (strcmp(cache->reg_list[i].name, name) == 0)
-				return &(cache->reg_list[i]);
-		}
+		struct reg *reg = register_cache_find(cache, name);
+		if (reg)
+			return reg;
 
 		if (search_all)
 			cache = cache->next;
@@ -91,6 +162,16 @@ void register_cache_invalidate(struct reg_cache *cache)
 	}
 }
 
+/** Frees the name index of a cache, to be called before freeing the cache.
+ * Like free(), it accepts NULL. */
+void register_cache_free_index(struct reg_cache *cache)
+{
+	if (cache == NULL)
+		return;
+	free(cache->name_index);
+	cache->name_index = NULL;
+}
+
 static int register_get_dummy_core_reg(struct reg *reg)
 {
 	return ERROR_OK;
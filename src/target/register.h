@@ -136,6 +136,17 @@ struct reg_cache {
 	struct reg_cache *next;
 	struct reg *reg_list;
 	unsigned num_regs;
+	/**
+	 * Optional: write all dirty registers back to the target in one batch
+	 * and mark them clean. Cores that can queue register writes install
+	 * this so that restoring a context takes a single adapter transaction.
+	 */
+	int (*flush)(struct reg_cache *cache);
+	/* index by name, built by register_get_by_name() */
+	struct reg **name_index;
+	unsigned name_index_size;
+	unsigned name_index_regs;
+	const struct reg *name_index_list;
 };
 
 struct reg_arch_type {
@@ -148,6 +159,7 @@ struct reg *register_get_by_name(struct reg_cache *first,
 struct reg_cache **register_get_last_cache_p(struct reg_cache **first);
 void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *cache);
 void register_cache_invalidate(struct reg_cache *cache);
+void register_cache_free_index(struct reg_cache *cache);
 
 void register_init_dummy(struct reg *reg);
 
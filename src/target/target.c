@@ -43,6 +43,10 @@
 #include "config.h"
 #endif
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
 #include <flash/nor/core.h>
@@ -69,12 +73,16 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 static int target_mem2array(Jim_Interp *interp, struct target *target,
 		int argc, Jim_Obj * const *argv);
 static int target_register_user_commands(struct command_context *cmd_ctx);
+static int target_restore_working_areas(struct target *target);
+static void target_working_area_written(struct target *target, bool phys,
+		uint32_t address, uint32_t size, const uint8_t *buffer);
+static bool target_working_area_read(struct target *target, bool phys,
+		uint32_t address, uint32_t size, uint8_t *buffer);
+static void target_free_flash_loaders(struct target *target);
 static int target_get_gdb_fileio_info_default(struct target *target,
 		struct gdb_fileio_info *fileio_info);
 static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
-static int target_profiling_default(struct target *target, uint32_t *samples,
-		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
 /* targets */
 extern struct target_type arm7tdmi_target;
@@ -607,6 +615,12 @@ int target_resume(struct target *target, int current, uint32_t address, int hand
 	 * we poll. The CPU can even halt at the current PC as a result of
 	 * a software breakpoint being inserted by (a bug?) the application.
 	 */
+	/* the application must see its own content of the working area */
+	if (!debug_execution) {
+		target_free_flash_loaders(target);
+		target_restore_working_areas(target);
+	}
+
 	retval = target->type->resume(target, current, address, handle_breakpoints, debug_execution);
 	if (retval != ERROR_OK)
 		return retval;
@@ -886,7 +900,7 @@ int target_run_flash_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point, void *arch_info)
 {
 	int retval;
-	int timeout = 0;
+	int64_t wait_start = 0;
 
 	const uint8_t *buffer_orig = buffer;
 
@@ -959,12 +973,17 @@ int target_run_flash_async_algorithm(struct target *target,
 			/* Throttle polling a bit if transfer is (much) faster than flash
 			 * programming. The exact delay shouldn't matter as long as it's
 			 * less than buffer size / flash speed. This is very unlikely to
-			 * run when using high latency connections such as USB. */
-			alive_sleep(10);
+			 * run when using high latency connections such as USB. When
+			 * several targets are programmed in parallel, feed the others
+			 * instead. */
+			if (!target_yield())
+				alive_sleep(10);
 
-			/* to stop an infinite loop on some targets check and increment a timeout
+			/* to stop an infinite loop on some targets check for a timeout
 			 * this issue was observed on a stellaris using the new ICDI interface */
-			if (timeout++ >= 500) {
+			if (wait_start == 0) {
+				wait_start = timeval_ms();
+			} else if (timeval_ms() - wait_start > 5000) {
 				LOG_ERROR("timeout waiting for algorithm, a target reset is recommended");
 				return ERROR_FLASH_OPERATION_FAILED;
 			}
@@ -972,7 +991,7 @@ int target_run_flash_async_algorithm(struct target *target,
 		}
 
 		/* reset our timeout */
-		timeout = 0;
+		wait_start = 0;
 
 		/* Limit to the amount of data we actually want to write */
 		if (thisrun_bytes > count * block_size)
@@ -994,6 +1013,9 @@ int target_run_flash_async_algorithm(struct target *target,
 		retval = target_write_u32(target, wp_addr, wp);
 		if (retval != ERROR_OK)
 			break;
+
+		/* let the other targets programmed in parallel fill their fifo */
+		target_yield();
 	}
 
 	if (retval != ERROR_OK) {
@@ -1015,6 +1037,277 @@ int target_run_flash_async_algorithm(struct target *target,
 	return retval;
 }
 
+#ifdef HAVE_PTHREAD_H
+/* Cooperative tasks of target_run_parallel(). Each task has a thread, but
+ * only the one holding the baton runs; it passes the baton on in
+ * target_yield() or when it's done, so the rest of OpenOCD never sees two
+ * of them at once. */
+struct target_task {
+	struct target *target;
+	int (*fn)(struct target *target, void *priv);
+	void *priv;
+	int retval;
+	bool done;
+	pthread_t thread;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct target_task *tasks;
+	int num_tasks;
+	int current;		/* task holding the baton */
+	int running;		/* tasks not done yet */
+} target_tasks = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* Pass the baton to the next task that isn't done, called with the lock held.
+ * @returns false if there is none other than the current one. */
+static bool target_task_switch(void)
+{
+	for (int i = 1; i < target_tasks.num_tasks; i++) {
+		int next = (target_tasks.current + i) % target_tasks.num_tasks;
+		if (!target_tasks.tasks[next].done) {
+			target_tasks.current = next;
+			pthread_cond_broadcast(&target_tasks.cond);
+			return true;
+		}
+	}
+	return false;
+}
+
+static void target_task_wait(struct target_task *task)
+{
+	while (&target_tasks.tasks[target_tasks.current] != task)
+		pthread_cond_wait(&target_tasks.cond, &target_tasks.lock);
+}
+
+static void *target_task_thread(void *arg)
+{
+	struct target_task *task = arg;
+
+	pthread_mutex_lock(&target_tasks.lock);
+	target_task_wait(task);
+	pthread_mutex_unlock(&target_tasks.lock);
+
+	task->retval = task->fn(task->target, task->priv);
+
+	pthread_mutex_lock(&target_tasks.lock);
+	task->done = true;
+	target_tasks.running--;
+	if (!target_task_switch())
+		pthread_cond_broadcast(&target_tasks.cond);
+	pthread_mutex_unlock(&target_tasks.lock);
+
+	return NULL;
+}
+
+bool target_yield(void)
+{
+	if (target_tasks.tasks == NULL)
+		return false;
+
+	pthread_mutex_lock(&target_tasks.lock);
+	struct target_task *task = &target_tasks.tasks[target_tasks.current];
+	bool switched = target_task_switch();
+	if (switched)
+		target_task_wait(task);
+	pthread_mutex_unlock(&target_tasks.lock);
+
+	return switched;
+}
+
+int target_run_parallel(struct target **targets, int num_targets,
+		int (*fn)(struct target *target, void *priv), void **privs, int *results)
+{
+	int retval = ERROR_OK;
+
+	if (target_tasks.tasks != NULL) {
+		LOG_ERROR("targets are already run in parallel");
+		return ERROR_FAIL;
+	}
+
+	struct target_task *tasks = calloc(num_targets, sizeof(*tasks));
+	if (tasks == NULL)
+		return ERROR_FAIL;
+
+	pthread_mutex_lock(&target_tasks.lock);
+	target_tasks.tasks = tasks;
+	target_tasks.num_tasks = num_targets;
+	target_tasks.current = 0;
+	target_tasks.running = 0;
+
+	int started;
+	for (started = 0; started < num_targets; started++) {
+		struct target_task *task = &tasks[started];
+		task->target = targets[started];
+		task->fn = fn;
+		task->priv = privs ? privs[started] : NULL;
+		if (pthread_create(&task->thread, NULL, target_task_thread, task) != 0) {
+			LOG_ERROR("failed to create a thread for target %s", target_name(task->target));
+			retval = ERROR_FAIL;
+			break;
+		}
+		target_tasks.running++;
+	}
+
+	/* tasks that couldn't be started never get the baton */
+	for (int i = started; i < num_targets; i++) {
+		tasks[i].retval = ERROR_FAIL;
+		tasks[i].done = true;
+	}
+
+	/* hand the baton to the first task and wait for all to finish */
+	if (started > 0)
+		pthread_cond_broadcast(&target_tasks.cond);
+	while (target_tasks.running > 0)
+		pthread_cond_wait(&target_tasks.cond, &target_tasks.lock);
+	pthread_mutex_unlock(&target_tasks.lock);
+
+	for (int i = 0; i < started; i++)
+		pthread_join(tasks[i].thread, NULL);
+
+	for (int i = 0; i < num_targets; i++) {
+		if (results)
+			results[i] = tasks[i].retval;
+		if (retval == ERROR_OK)
+			retval = tasks[i].retval;
+	}
+
+	target_tasks.tasks = NULL;
+	target_tasks.num_tasks = 0;
+	free(tasks);
+
+	return retval;
+}
+#else
+/* Without threads, the tasks run one after the other */
+bool target_yield(void)
+{
+	return false;
+}
+
+int target_run_parallel(struct target **targets, int num_targets,
+		int (*fn)(struct target *target, void *priv), void **privs, int *results)
+{
+	int retval = ERROR_OK;
+
+	for (int i = 0; i < num_targets; i++) {
+		int result = fn(targets[i], privs ? privs[i] : NULL);
+		if (results)
+			results[i] = result;
+		if (retval == ERROR_OK)
+			retval = result;
+	}
+
+	return retval;
+}
+#endif
+
+static void target_unlink_flash_loader(struct target *target, struct flash_loader **prev)
+{
+	struct flash_loader *loader = *prev;
+
+	*prev = loader->next;
+	if (loader->area)
+		target_free_working_area(target, loader->area);
+	free(loader->code);
+	free(loader);
+}
+
+/* Drop all resident flash loaders */
+static void target_free_flash_loaders(struct target *target)
+{
+	while (target->flash_loaders)
+		target_unlink_flash_loader(target, &target->flash_loaders);
+}
+
+/* Drop the resident flash loaders overwritten by a memory write */
+static void target_flash_loaders_written(struct target *target, uint32_t address, uint32_t size)
+{
+	struct flash_loader **prev = &target->flash_loaders;
+
+	while (*prev) {
+		struct working_area *area = (*prev)->area;
+		if (area && address < area->address + area->size && area->address < address + size) {
+			LOG_DEBUG("flash loader at 0x%08"PRIx32" overwritten", area->address);
+			target_unlink_flash_loader(target, prev);
+		} else {
+			prev = &(*prev)->next;
+		}
+	}
+}
+
+int target_alloc_flash_loader(struct target *target,
+		const uint8_t *code, uint32_t size, struct working_area **area)
+{
+	uint32_t crc = image_crc32_update(IMAGE_CRC32_INIT, code, size);
+	struct flash_loader **prev = &target->flash_loaders;
+
+	while (*prev) {
+		struct flash_loader *loader = *prev;
+		if (loader->area == NULL) {
+			/* freed along with all working areas */
+			target_unlink_flash_loader(target, prev);
+			continue;
+		}
+		if (loader->crc == crc && loader->size == size && !memcmp(loader->code, code, size)) {
+			LOG_DEBUG("reusing flash loader at 0x%08"PRIx32, loader->area->address);
+			*area = loader->area;
+			return ERROR_OK;
+		}
+		prev = &loader->next;
+	}
+
+	struct flash_loader *loader = calloc(1, sizeof(*loader));
+	if (loader == NULL)
+		return ERROR_FAIL;
+	loader->code = malloc(size);
+	if (loader->code == NULL) {
+		free(loader);
+		return ERROR_FAIL;
+	}
+	memcpy(loader->code, code, size);
+	loader->crc = crc;
+	loader->size = size;
+
+	/* make room by dropping the other loaders if needed */
+	int retval = target_alloc_working_area_try(target, size, &loader->area);
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE && target->flash_loaders) {
+		target_free_flash_loaders(target);
+		retval = target_alloc_working_area_try(target, size, &loader->area);
+	}
+	if (retval == ERROR_OK)
+		retval = target_write_buffer(target, loader->area->address, size, code);
+	if (retval != ERROR_OK) {
+		if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			LOG_WARNING("not enough working area available(requested %"PRIu32")", size);
+		if (loader->area)
+			target_free_working_area(target, loader->area);
+		free(loader->code);
+		free(loader);
+		return retval;
+	}
+
+	loader->next = target->flash_loaders;
+	target->flash_loaders = loader;
+	*area = loader->area;
+
+	return ERROR_OK;
+}
+
+void target_free_flash_loader(struct target *target, struct working_area *area)
+{
+	for (struct flash_loader **prev = &target->flash_loaders; *prev; prev = &(*prev)->next) {
+		if ((*prev)->area == area) {
+			target_unlink_flash_loader(target, prev);
+			return;
+		}
+	}
+}
+
 int target_read_memory(struct target *target,
 		uint32_t address, uint32_t size, uint32_t count, uint8_t *buffer)
 {
@@ -1026,7 +1319,10 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
-	return target->type->read_memory(target, address, size, count, buffer);
+	int retval = target->type->read_memory(target, address, size, count, buffer);
+	if (retval == ERROR_OK)
+		target_working_area_read(target, false, address, size * count, buffer);
+	return retval;
 }
 
 int target_read_phys_memory(struct target *target,
@@ -1040,7 +1336,10 @@ int target_read_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
-	return target->type->read_phys_memory(target, address, size, count, buffer);
+	int retval = target->type->read_phys_memory(target, address, size, count, buffer);
+	if (retval == ERROR_OK)
+		target_working_area_read(target, true, address, size * count, buffer);
+	return retval;
 }
 
 int target_write_memory(struct target *target,
@@ -1054,6 +1353,9 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	if (target->flash_loaders)
+		target_flash_loaders_written(target, address, size * count);
+	target_working_area_written(target, false, address, size * count, buffer);
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1068,6 +1370,7 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	target_working_area_written(target, true, address, size * count, buffer);
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1148,6 +1451,9 @@ int target_get_gdb_reg_list(struct target *target,
 int target_step(struct target *target,
 		int current, uint32_t address, int handle_breakpoints)
 {
+	target_free_flash_loaders(target);
+	target_restore_working_areas(target);
+
 	return target->type->step(target, current, address, handle_breakpoints);
 }
 
@@ -1611,14 +1917,42 @@ int target_call_timer_callbacks_now(void)
 	return target_call_timer_callbacks_check_time(0);
 }
 
+int target_timer_next_due_ms(void)
+{
+	struct timeval now;
+	int64_t next_us = -1;
+
+	gettimeofday(&now, NULL);
+
+	for (struct target_timer_callback *c = target_timer_callbacks;
+	     c; c = c->next) {
+		if (c->removed || !c->callback)
+			continue;
+
+		int64_t delta_us = ((int64_t)c->when.tv_sec - now.tv_sec) * 1000000
+			+ (c->when.tv_usec - now.tv_usec);
+		if (delta_us < 0)
+			delta_us = 0;
+		if (next_us < 0 || delta_us < next_us)
+			next_us = delta_us;
+	}
+
+	if (next_us < 0)
+		return -1;
+
+	/* round up, waking early would only make us sleep again */
+	int64_t next_ms = (next_us + 999) / 1000;
+	return next_ms > INT_MAX ? INT_MAX : (int)next_ms;
+}
+
 /* Prints the working area layout for debug purposes */
 static void print_wa_layout(struct target *target)
 {
 	struct working_area *c = target->working_areas;
 
 	while (c) {
-		LOG_DEBUG("%c%c 0x%08"PRIx32"-0x%08"PRIx32" (%"PRIu32" bytes)",
-			c->backup ? 'b' : ' ', c->free ? ' ' : '*',
+		LOG_DEBUG("%c 0x%08"PRIx32"-0x%08"PRIx32" (%"PRIu32" bytes)",
+			c->free ? ' ' : '*',
 			c->address, c->address + c->size - 1, c->size);
 		c = c->next;
 	}
@@ -1640,19 +1974,11 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->next = area->next;
 		new_wa->size = area->size - size;
 		new_wa->address = area->address + size;
-		new_wa->backup = NULL;
 		new_wa->user = NULL;
 		new_wa->free = true;
 
 		area->next = new_wa;
 		area->size = size;
-
-		/* If backup memory was allocated to this area, it has the wrong size
-		 * now so free it and it will be reallocated if/when needed */
-		if (area->backup) {
-			free(area->backup);
-			area->backup = NULL;
-		}
 	}
 }
 
@@ -1672,22 +1998,196 @@ static void target_merge_working_areas(struct target *target)
 			/* Remove the last */
 			struct working_area *to_be_freed = c->next;
 			c->next = c->next->next;
-			if (to_be_freed->backup)
-				free(to_be_freed->backup);
 			free(to_be_freed);
-
-			/* If backup memory was allocated to the remaining area, it's has
-			 * the wrong size now */
-			if (c->backup) {
-				free(c->backup);
-				c->backup = NULL;
-			}
 		} else {
 			c = c->next;
 		}
 	}
 }
 
+/* The backup of the working area is kept per word for as long as the target
+ * stays halted: allocating a region only reads the words that weren't saved
+ * yet, freeing it writes nothing, and all saved words are written back once
+ * before the target resumes or steps. Memory writes to free regions replace
+ * their backup, so what is written back is the latest content the user
+ * wrote there, and memory reads of free regions return the backup instead
+ * of what the last algorithm left behind. Physical accesses only match when
+ * the working area was set up with the MMU off. */
+static inline bool wa_word_saved(const uint32_t *saved, uint32_t word)
+{
+	return saved[word / 32] & (1u << (word % 32));
+}
+
+static int target_backup_working_area(struct target *target, struct working_area *area)
+{
+	uint32_t base = target->working_areas->address;
+
+	if (target->working_area_backup == NULL) {
+		uint32_t size = 0;
+		for (struct working_area *c = target->working_areas; c; c = c->next)
+			size += c->size;
+
+		target->working_area_backup = malloc(size);
+		target->working_area_saved = calloc(DIV_ROUND_UP(size / 4, 32), sizeof(uint32_t));
+		if (target->working_area_backup == NULL || target->working_area_saved == NULL) {
+			free(target->working_area_backup);
+			free(target->working_area_saved);
+			target->working_area_backup = NULL;
+			target->working_area_saved = NULL;
+			return ERROR_FAIL;
+		}
+	}
+
+	uint32_t *saved = target->working_area_saved;
+	uint32_t word = (area->address - base) / 4;
+	uint32_t end = word + area->size / 4;
+
+	while (word < end) {
+		if (wa_word_saved(saved, word)) {
+			word++;
+			continue;
+		}
+
+		uint32_t last = word;
+		while (last < end && !wa_word_saved(saved, last))
+			last++;
+
+		int retval = target_read_memory(target, base + word * 4, 4, last - word,
+				target->working_area_backup + word * 4);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (; word < last; word++)
+			saved[word / 32] |= 1u << (word % 32);
+	}
+
+	return ERROR_OK;
+}
+
+/* Update the backup for a memory write, which is not a write to an
+ * allocated area by its user */
+static void target_working_area_written(struct target *target, bool phys,
+		uint32_t address, uint32_t size, const uint8_t *buffer)
+{
+	uint32_t *saved = target->working_area_saved;
+
+	if (saved == NULL || (phys && !target->working_area_is_phys))
+		return;
+
+	uint32_t base = target->working_areas->address;
+	uint64_t write_end = (uint64_t)address + size;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (!c->free)
+			continue;
+
+		uint64_t start = address > c->address ? address : c->address;
+		uint64_t end = MIN(write_end, (uint64_t)c->address + c->size);
+
+		while (start < end) {
+			uint32_t offset = start - base;
+			uint32_t word = offset / 4;
+			uint64_t word_end = MIN((uint64_t)base + (word + 1) * 4, end);
+
+			if (offset % 4 == 0 && word_end - start == 4) {
+				/* fully overwritten, nothing to restore */
+				saved[word / 32] &= ~(1u << (word % 32));
+			} else if (wa_word_saved(saved, word)) {
+				/* keep the new bytes when the word is restored */
+				memcpy(target->working_area_backup + offset,
+						buffer + (start - address), word_end - start);
+			}
+			start = word_end;
+		}
+	}
+}
+
+/* Replace the bytes of a memory read that lie in saved words of free
+ * regions by their backup; with a NULL buffer, only tell whether any do */
+static bool target_working_area_read(struct target *target, bool phys,
+		uint32_t address, uint32_t size, uint8_t *buffer)
+{
+	uint32_t *saved = target->working_area_saved;
+	bool overlaid = false;
+
+	if (saved == NULL || (phys && !target->working_area_is_phys))
+		return false;
+
+	uint32_t base = target->working_areas->address;
+	uint64_t read_end = (uint64_t)address + size;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		if (!c->free)
+			continue;
+
+		uint64_t start = address > c->address ? address : c->address;
+		uint64_t end = MIN(read_end, (uint64_t)c->address + c->size);
+
+		while (start < end) {
+			uint32_t offset = start - base;
+			uint32_t word = offset / 4;
+			uint64_t word_end = MIN((uint64_t)base + (word + 1) * 4, end);
+
+			if (wa_word_saved(saved, word)) {
+				if (buffer == NULL)
+					return true;
+				memcpy(buffer + (start - address),
+						target->working_area_backup + offset, word_end - start);
+				overlaid = true;
+			}
+			start = word_end;
+		}
+	}
+
+	return overlaid;
+}
+
+/* Write all saved words back to the target and drop the backup */
+static int target_restore_working_areas(struct target *target)
+{
+	int retval = ERROR_OK;
+	uint32_t *saved = target->working_area_saved;
+	uint8_t *backup = target->working_area_backup;
+
+	if (saved == NULL)
+		return ERROR_OK;
+
+	/* the writes below are not user writes to track */
+	target->working_area_backup = NULL;
+	target->working_area_saved = NULL;
+
+	uint32_t base = target->working_areas->address;
+	uint32_t words = 0;
+	for (struct working_area *c = target->working_areas; c; c = c->next)
+		words += c->size / 4;
+
+	uint32_t word = 0;
+	while (word < words) {
+		if (!wa_word_saved(saved, word)) {
+			word++;
+			continue;
+		}
+
+		uint32_t last = word;
+		while (last < words && wa_word_saved(saved, last))
+			last++;
+
+		int retval2 = target_write_memory(target, base + word * 4, 4, last - word,
+				backup + word * 4);
+		if (retval2 != ERROR_OK) {
+			LOG_ERROR("failed to restore %"PRIu32" bytes of working area at address 0x%08"PRIx32,
+					(last - word) * 4, base + word * 4);
+			retval = retval2;
+		}
+		word = last;
+	}
+
+	free(backup);
+	free(saved);
+
+	return retval;
+}
+
 int target_alloc_working_area_try(struct target *target, uint32_t size, struct working_area **area)
 {
 	/* Reevaluate working area address based on MMU state*/
@@ -1705,6 +2205,7 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 					"address for working memory 0x%08"PRIx32,
 					target->working_area_phys);
 				target->working_area = target->working_area_phys;
+				target->working_area_is_phys = true;
 			} else {
 				LOG_ERROR("No working memory available. "
 					"Specify -work-area-phys to target.");
@@ -1716,6 +2217,7 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 					"address for working memory 0x%08"PRIx32,
 					target->working_area_virt);
 				target->working_area = target->working_area_virt;
+				target->working_area_is_phys = false;
 			} else {
 				LOG_ERROR("No working memory available. "
 					"Specify -work-area-virt to target.");
@@ -1729,7 +2231,6 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			new_wa->next = NULL;
 			new_wa->size = target->working_area_size & ~3UL; /* 4-byte align */
 			new_wa->address = target->working_area;
-			new_wa->backup = NULL;
 			new_wa->user = NULL;
 			new_wa->free = true;
 		}
@@ -1741,13 +2242,19 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	if (size % 4)
 		size = (size + 3) & (~3UL);
 
-	struct working_area *c = target->working_areas;
+	struct working_area *c = NULL;
 
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
+	/* Find the smallest large enough working area; this keeps large areas
+	 * available and hands the same region, whose backup is already taken,
+	 * to the next allocation of the same size. */
+	for (struct working_area *w = target->working_areas; w; w = w->next) {
+		if (!w->free || w->size < size)
+			continue;
+		if (c == NULL || w->size < c->size) {
+			c = w;
+			if (c->size == size)
+				break;
+		}
 	}
 
 	if (c == NULL)
@@ -1759,15 +2266,11 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	LOG_DEBUG("allocated new working area of %"PRIu32" bytes at address 0x%08"PRIx32, size, c->address);
 
 	if (target->backup_working_area) {
-		if (c->backup == NULL) {
-			c->backup = malloc(c->size);
-			if (c->backup == NULL)
-				return ERROR_FAIL;
-		}
-
-		int retval = target_read_memory(target, c->address, 4, c->size / 4, c->backup);
-		if (retval != ERROR_OK)
+		int retval = target_backup_working_area(target, c);
+		if (retval != ERROR_OK) {
+			target_merge_working_areas(target);
 			return retval;
+		}
 	}
 
 	/* mark as used, and return the new (reused) area */
@@ -1793,34 +2296,11 @@ int target_alloc_working_area(struct target *target, uint32_t size, struct worki
 
 }
 
-static int target_restore_working_area(struct target *target, struct working_area *area)
-{
-	int retval = ERROR_OK;
-
-	if (target->backup_working_area && area->backup != NULL) {
-		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
-		if (retval != ERROR_OK)
-			LOG_ERROR("failed to restore %"PRIu32" bytes of working area at address 0x%08"PRIx32,
-					area->size, area->address);
-	}
-
-	return retval;
-}
-
-/* Restore the area's backup memory, if any, and return the area to the allocation pool */
-static int target_free_working_area_restore(struct target *target, struct working_area *area, int restore)
+/* Return the area to the allocation pool; its backup is kept until the target resumes */
+int target_free_working_area(struct target *target, struct working_area *area)
 {
-	int retval = ERROR_OK;
-
 	if (area->free)
-		return retval;
-
-	if (restore) {
-		retval = target_restore_working_area(target, area);
-		/* REVISIT: Perhaps the area should be freed even if restoring fails. */
-		if (retval != ERROR_OK)
-			return retval;
-	}
+		return ERROR_OK;
 
 	area->free = true;
 
@@ -1838,12 +2318,7 @@ static int target_free_working_area_restore(struct target *target, struct workin
 
 	print_wa_layout(target);
 
-	return retval;
-}
-
-int target_free_working_area(struct target *target, struct working_area *area)
-{
-	return target_free_working_area_restore(target, area, 1);
+	return ERROR_OK;
 }
 
 void target_quit(void)
@@ -1866,6 +2341,9 @@ void target_quit(void)
 
 	for (struct target *target = all_targets;
 	     target; target = target->next) {
+		/* don't leave helper code behind in a halted target */
+		if (target->state == TARGET_HALTED)
+			target_restore_working_areas(target);
 		if (target->type->deinit_target)
 			target->type->deinit_target(target);
 	}
@@ -1880,11 +2358,11 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 
 	LOG_DEBUG("freeing all working areas");
 
-	/* Loop through all areas, restoring the allocated ones and marking them as free */
+	target_free_flash_loaders(target);
+
+	/* Loop through all areas, marking the allocated ones as free */
 	while (c) {
 		if (!c->free) {
-			if (restore)
-				target_restore_working_area(target, c);
 			c->free = true;
 			*c->user = NULL; /* Same as above */
 			c->user = NULL;
@@ -1892,6 +2370,16 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 		c = c->next;
 	}
 
+	if (restore) {
+		target_restore_working_areas(target);
+	} else {
+		/* the memory is gone anyway, drop the backup */
+		free(target->working_area_backup);
+		free(target->working_area_saved);
+		target->working_area_backup = NULL;
+		target->working_area_saved = NULL;
+	}
+
 	/* Run a merge pass to combine all areas into one */
 	target_merge_working_areas(target);
 
@@ -1955,7 +2443,7 @@ static int target_gdb_fileio_end_default(struct target *target,
 	return ERROR_OK;
 }
 
-static int target_profiling_default(struct target *target, uint32_t *samples,
+int target_profiling_default(struct target *target, uint32_t *samples,
 		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
 	struct timeval timeout, now;
@@ -2029,6 +2517,10 @@ int target_write_buffer(struct target *target, uint32_t address, uint32_t size,
 		return ERROR_FAIL;
 	}
 
+	if (target->flash_loaders)
+		target_flash_loaders_written(target, address, size);
+	target_working_area_written(target, false, address, size, buffer);
+
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2090,7 +2582,10 @@ int target_read_buffer(struct target *target, uint32_t address, uint32_t size, u
 		return ERROR_FAIL;
 	}
 
-	return target->type->read_buffer(target, address, size, buffer);
+	int retval = target->type->read_buffer(target, address, size, buffer);
+	if (retval == ERROR_OK)
+		target_working_area_read(target, false, address, size, buffer);
+	return retval;
 }
 
 static int target_read_buffer_default(struct target *target, uint32_t address, uint32_t count, uint8_t *buffer)
@@ -2137,7 +2632,12 @@ int target_checksum_memory(struct target *target, uint32_t address, uint32_t siz
 		return ERROR_FAIL;
 	}
 
-	retval = target->type->checksum_memory(target, address, size, &checksum);
+	/* the algorithm would see what the working area holds now, not the
+	 * backup which is the content before it was used */
+	if (target_working_area_read(target, false, address, size, NULL))
+		retval = ERROR_FAIL;
+	else
+		retval = target->type->checksum_memory(target, address, size, &checksum);
 	if (retval != ERROR_OK) {
 		buffer = malloc(size);
 		if (buffer == NULL) {
@@ -2888,7 +3388,7 @@ COMMAND_HANDLER(handle_step_command)
 
 	struct target *target = get_current_target(CMD_CTX);
 
-	return target->type->step(target, current_pc, addr, 1);
+	return target_step(target, current_pc, addr, 1);
 }
 
 static void handle_md_output(struct command_context *cmd_ctx,
@@ -3132,9 +3632,13 @@ static COMMAND_HELPER(parse_load_image_command_CMD_ARGV, struct image *image,
 	return ERROR_OK;
 }
 
+/* load_image streams sections through a buffer of this size, so host
+ * memory use doesn't depend on the size of the image */
+#define LOAD_IMAGE_CHUNK_SIZE	(64 * 1024)
+
 COMMAND_HANDLER(handle_load_image_command)
 {
-	uint8_t *buffer;
+	uint8_t *buffer = NULL;
 	size_t buf_cnt;
 	uint32_t image_size;
 	uint32_t min_address = 0;
@@ -3155,59 +3659,95 @@ COMMAND_HANDLER(handle_load_image_command)
 	if (image_open(&image, CMD_ARGV[0], (CMD_ARGC >= 3) ? CMD_ARGV[2] : NULL) != ERROR_OK)
 		return ERROR_OK;
 
+	/* time spent reading the image vs. writing to the target */
+	float file_time = 0, target_time = 0;
+	uint32_t file_bytes = 0;
+
 	image_size = 0x0;
 	retval = ERROR_OK;
-	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD_CTX,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
-		}
-
-		uint32_t offset = 0;
-		uint32_t length = buf_cnt;
+	for (i = 0; i < image.num_sections && retval == ERROR_OK; i++) {
+		uint32_t base = image.sections[i].base_address;
+		uint32_t size = image.sections[i].size;
 
 		/* DANGER!!! beware of unsigned comparision here!!! */
 
-		if ((image.sections[i].base_address + buf_cnt >= min_address) &&
-				(image.sections[i].base_address < max_address)) {
+		if ((base + size < min_address) || (base >= max_address))
+			continue;
 
-			if (image.sections[i].base_address < min_address) {
-				/* clip addresses below */
-				offset += min_address-image.sections[i].base_address;
-				length -= offset;
+		/* clip addresses below and above */
+		uint32_t offset = 0;
+		uint32_t end = size;
+		if (base < min_address)
+			offset = min_address - base;
+		if (base + size > max_address)
+			end -= (base + size) - max_address;
+
+		uint32_t start = offset;
+		uint32_t length = end - offset;
+		while (offset < end) {
+			uint32_t chunk = end - offset;
+			if (chunk > LOAD_IMAGE_CHUNK_SIZE)
+				chunk = LOAD_IMAGE_CHUNK_SIZE;
+
+			struct duration phase;
+			duration_start(&phase);
+
+			const uint8_t *data = image_section_data(&image, i, offset, chunk);
+			if (!data) {
+				if (buffer == NULL) {
+					buffer = malloc(LOAD_IMAGE_CHUNK_SIZE);
+					if (buffer == NULL) {
+						command_print(CMD_CTX,
+								"error allocating buffer for section (%d bytes)",
+								LOAD_IMAGE_CHUNK_SIZE);
+						retval = ERROR_FAIL;
+						break;
+					}
+				}
+
+				retval = image_read_section(&image, i, offset, chunk, buffer, &buf_cnt);
+				if (retval != ERROR_OK)
+					break;
+				if (buf_cnt == 0) {
+					retval = ERROR_FAIL;
+					break;
+				}
+				chunk = buf_cnt;
+				data = buffer;
 			}
 
-			if (image.sections[i].base_address + buf_cnt > max_address)
-				length -= (image.sections[i].base_address + buf_cnt)-max_address;
+			duration_measure(&phase);
+			file_time += duration_elapsed(&phase);
+			file_bytes += chunk;
 
-			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
-			if (retval != ERROR_OK) {
-				free(buffer);
+			duration_start(&phase);
+			retval = target_write_buffer(target, base + offset, chunk, data);
+			if (retval != ERROR_OK)
 				break;
-			}
-			image_size += length;
-			command_print(CMD_CTX, "%u bytes written at address 0x%8.8" PRIx32 "",
-					(unsigned int)length,
-					image.sections[i].base_address + offset);
+			duration_measure(&phase);
+			target_time += duration_elapsed(&phase);
+
+			offset += chunk;
 		}
+		if (retval != ERROR_OK)
+			break;
 
-		free(buffer);
+		image_size += length;
+		command_print(CMD_CTX, "%u bytes written at address 0x%8.8" PRIx32 "",
+				(unsigned int)length,
+				base + start);
 	}
 
+	free(buffer);
+
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD_CTX, "downloaded %" PRIu32 " bytes "
 				"in %fs (%0.3f KiB/s)", image_size,
 				duration_elapsed(&bench), duration_kbps(&bench, image_size));
+		command_print(CMD_CTX, "image read %fs (%0.3f KiB/s), "
+				"target write %fs (%0.3f KiB/s)",
+				file_time, file_time > 0 ? file_bytes / 1024.0 / file_time : 0.0,
+				target_time, target_time > 0 ? image_size / 1024.0 / target_time : 0.0);
 	}
 
 	image_close(&image);
@@ -3794,7 +4334,8 @@ COMMAND_HANDLER(handle_profile_command)
 	if ((CMD_ARGC != 2) && (CMD_ARGC != 4))
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
-	const uint32_t MAX_PROFILE_SAMPLE_NUM = 10000;
+	/* enough for targets which sample without halting, e.g. Cortex-M */
+	const uint32_t MAX_PROFILE_SAMPLE_NUM = 1000000;
 	uint32_t offset;
 	uint32_t num_of_samples;
 	int retval = ERROR_OK;
@@ -98,11 +98,19 @@ struct working_area {
 	uint32_t address;
 	uint32_t size;
 	bool free;
-	uint8_t *backup;
 	struct working_area **user;
 	struct working_area *next;
 };
 
+/* A flash loader algorithm kept resident in a working area */
+struct flash_loader {
+	uint32_t crc;						/* image_crc32_update() of the code */
+	uint32_t size;
+	uint8_t *code;						/* copy of the code, to confirm a crc match */
+	struct working_area *area;			/* NULL once freed along with all working areas */
+	struct flash_loader *next;
+};
+
 struct gdb_service {
 	struct target *target;
 	/*  field for smp display  */
@@ -124,6 +132,10 @@ enum target_register_class {
 	REG_CLASS_GENERAL,
 };
 
+/* number of buckets of the breakpoint and watchpoint address index */
+#define BREAKPOINT_HASH_BITS	6
+#define BREAKPOINT_HASH_SIZE	(1 << BREAKPOINT_HASH_BITS)
+
 /* target_type.h contains the full definition of struct target_type */
 struct target {
 	struct target_type *type;			/* target type definition (name, access functions) */
@@ -158,9 +170,14 @@ struct target {
 	uint32_t working_area_virt;			/* virtual address */
 	bool working_area_phys_spec;		/* virtual address specified? */
 	uint32_t working_area_phys;			/* physical address */
+	bool working_area_is_phys;			/* working_area was evaluated with the MMU off */
 	uint32_t working_area_size;			/* size in bytes */
 	uint32_t backup_working_area;		/* whether the content of the working area has to be preserved */
 	struct working_area *working_areas;/* list of allocated working areas */
+	uint8_t *working_area_backup;		/* saved content of the working area, valid for the
+										 * words set in working_area_saved */
+	uint32_t *working_area_saved;		/* bitmap of backed up words, restored on resume */
+	struct flash_loader *flash_loaders;	/* resident flash loader algorithms */
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
 	/* also see: target_state_name() */
@@ -168,6 +185,8 @@ struct target {
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
+	struct breakpoint *breakpoint_hash[BREAKPOINT_HASH_SIZE];	/* breakpoints by address */
+	struct watchpoint *watchpoint_hash[BREAKPOINT_HASH_SIZE];	/* watchpoints by address */
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
 	uint32_t dbg_msg_enabled;			/* debug message status */
@@ -371,6 +390,14 @@ int target_call_timer_callbacks(void);
  * a synchronous command completes.
  */
 int target_call_timer_callbacks_now(void);
+/**
+ * Get the delay until the earliest registered timer callback is due, so
+ * that the server loop can sleep exactly that long.
+ *
+ * @returns Milliseconds until the next callback is due (0 if one is
+ * already overdue), or -1 if no timer callback is registered.
+ */
+int target_timer_next_due_ms(void);
 
 struct target *get_target_by_num(int num);
 struct target *get_current_target(struct command_context *cmd_ctx);
@@ -518,6 +545,40 @@ int target_run_flash_async_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point,
 		void *arch_info);
 
+/**
+ * Run @a fn for each of the @a targets as cooperative tasks, e.g. to
+ * program their flash in parallel. Only one task runs at a time; it hands
+ * over to the next one in target_yield(), which target_run_flash_async_algorithm()
+ * calls whenever it has fed its fifo, so one target's flash programming
+ * overlaps with the transfers to the others. Hosts without pthreads run
+ * the tasks one after the other.
+ *
+ * @param privs Per-target argument for @a fn, or NULL.
+ * @param results If not NULL, receives the result of each task.
+ * @returns ERROR_OK, or the result of the first failed task.
+ */
+int target_run_parallel(struct target **targets, int num_targets,
+		int (*fn)(struct target *target, void *priv), void **privs, int *results);
+/**
+ * Let the next task of target_run_parallel() run.
+ * @returns false if there is no other task, e.g. outside target_run_parallel().
+ */
+bool target_yield(void);
+
+/**
+ * Get a working area holding the flash loader @a code, uploading it only
+ * if it isn't resident from an earlier call. The area stays allocated until
+ * the target resumes, steps or is reset, or a write overlaps it; callers
+ * must not free it with target_free_working_area().
+ */
+int target_alloc_flash_loader(struct target *target,
+		const uint8_t *code, uint32_t size, struct working_area **area);
+/**
+ * Drop a resident flash loader, e.g. to make room for a buffer or when the
+ * loader failed and its code can't be trusted anymore.
+ */
+void target_free_flash_loader(struct target *target, struct working_area *area);
+
 /**
  * Read @a count items of @a size bytes from the memory of @a target at
  * the @a address given.
@@ -598,6 +659,15 @@ int target_get_gdb_fileio_info(struct target *target, struct gdb_fileio_info *fi
  */
 int target_gdb_fileio_end(struct target *target, int retcode, int fileio_errno, bool ctrl_c);
 
+/**
+ * Sample the PC by halting and resuming the target as often as possible.
+ *
+ * This is the default target->type->profiling; target types which can
+ * sample without halting may still fall back to it.
+ */
+int target_profiling_default(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
+
 
 
 /** Return the *name* of this targets current state */